@@ -22,4 +22,75 @@ export class LexerHttp {
         const tokens = await axios.post<IToken[]>(`${this.serverUrl}/lexer`, code);
         return tokens.data;
     }
+}
+
+export interface ITokenEdit {
+    start: number;
+    deleted: number;
+    lineDelta: number;
+    shiftedLine: number;
+    columnDelta: number;
+    tokens: IToken[];
+    error: { line: number; column: number } | null;
+}
+
+// The server keeps the source of the socket, only the edits are sent and only the changed Tokens come back
+export class LexerSocket {
+    serverUrl = "ws://localhost:8000/lexer/ws";
+
+    private socket: WebSocket;
+    private pending: Uint8Array[] = [];
+    private encoder = new TextEncoder();
+
+    constructor(onEdit: (edit: ITokenEdit) => void, onInvalid: () => void) {
+        this.socket = new WebSocket(this.serverUrl);
+
+        this.socket.onopen = () => {
+            this.pending.forEach((message) => this.socket.send(message));
+            this.pending = [];
+        };
+
+        this.socket.onmessage = (event) => {
+            const edit = JSON.parse(event.data);
+
+            if (typeof edit.error === "string") onInvalid();
+            else onEdit(edit);
+        };
+    }
+
+    public get isOpen(): boolean {
+        return this.socket.readyState === WebSocket.CONNECTING || this.socket.readyState === WebSocket.OPEN;
+    }
+
+    // The offset and the deleted size are in bytes of the UTF-8 source
+    public sendEdit(offset: number, deleted: number, inserted: string): void {
+        const bytes = this.encoder.encode(inserted);
+        const message = new Uint8Array(8 + bytes.length);
+        const view = new DataView(message.buffer);
+
+        view.setUint32(0, offset, true);
+        view.setUint32(4, deleted, true);
+        message.set(bytes, 8);
+
+        if (this.socket.readyState === WebSocket.CONNECTING) this.pending.push(message);
+        else this.socket.send(message);
+    }
+
+    public close(): void {
+        this.socket.close();
+    }
+}
+
+export function applyTokenEdit(tokens: IToken[], edit: ITokenEdit): IToken[] {
+    const kept = tokens.slice(edit.start + edit.deleted);
+
+    for (const token of kept) {
+        for (const position of [token.location.start, token.location.end]) {
+            if (position.line === edit.shiftedLine) position.column += edit.columnDelta;
+
+            position.line += edit.lineDelta;
+        }
+    }
+
+    return tokens.slice(0, edit.start).concat(edit.tokens, kept);
 }
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#define LG_CACHE_LINE_SIZE 64
+
+/*
+    Same sequence numbers of the Work Queue (see workQueue.c), but each cell
+    keeps the line itself, so logging doesn't allocate. The semaphore counts
+    the lines in the ring and the logger thread writes all of them before
+    flushing the output.
+*/
+struct cell {
+    atomic_size_t sequence;
+    size_t lineSize;
+    char line[LOGGER_LINE_MAX_SIZE];
+};
+
+struct logger {
+    struct cell* cells;
+    size_t mask;
+    FILE* output;
+    pthread_t thread;
+    sem_t available;
+    atomic_bool stopping;
+    atomic_size_t dropped;
+    _Alignas(LG_CACHE_LINE_SIZE) atomic_size_t pushPosition;
+    _Alignas(LG_CACHE_LINE_SIZE) atomic_size_t popPosition;
+};
+
+void* LG_mallocOrExitWithError(size_t size) {
+    void* m = malloc(size);
+
+    if (m == NULL) {
+        fprintf(stderr, "Logger Error: Unable to allocate %lu bytes\n", size);
+        exit(1);
+    }
+
+    return m;
+}
+
+size_t LG_roundUpToPowerOfTwo(size_t value) {
+    size_t power = 2;
+
+    while (power < value)
+        power *= 2;
+
+    return power;
+}
+
+struct cell* LG_reserveCell(Logger* lg, size_t* position) {
+    *position = atomic_load_explicit(&lg->pushPosition, memory_order_relaxed);
+
+    while (true) {
+        struct cell* cell = &lg->cells[*position & lg->mask];
+
+        const size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        const intptr_t difference = (intptr_t) sequence - (intptr_t) *position;
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&lg->pushPosition, position, *position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                return cell;
+        }
+        else if (difference < 0)
+            return NULL;
+        else
+            *position = atomic_load_explicit(&lg->pushPosition, memory_order_relaxed);
+    }
+}
+
+//Only the logger thread pops, so there is no race on the position
+bool LG_writeNextLine(Logger* lg) {
+    const size_t position = atomic_load_explicit(&lg->popPosition, memory_order_relaxed);
+    struct cell* cell = &lg->cells[position & lg->mask];
+
+    const size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+
+    if (sequence != position + 1)
+        return false;
+
+    fwrite(cell->line, 1, cell->lineSize, lg->output);
+
+    atomic_store_explicit(&lg->popPosition, position + 1, memory_order_relaxed);
+    atomic_store_explicit(&cell->sequence, position + lg->mask + 1, memory_order_release);
+
+    return true;
+}
+
+void* LG_run(void* arg) {
+    Logger* lg = (Logger*) arg;
+
+    while (true) {
+        while (sem_wait(&lg->available) != 0);
+
+        //One wake up can write many lines, the extra counts only find the ring empty
+        while (LG_writeNextLine(lg));
+
+        const size_t dropped = atomic_exchange(&lg->dropped, 0);
+
+        if (dropped > 0)
+            fprintf(lg->output, "Logger: %lu lines dropped, the ring was full\n", dropped);
+
+        fflush(lg->output);
+
+        if (atomic_load(&lg->stopping))
+            return NULL;
+    }
+}
+
+Logger* logger_init(size_t capacity, FILE* output) {
+    Logger* lg = (Logger*) aligned_alloc(LG_CACHE_LINE_SIZE, sizeof(Logger));
+
+    if (lg != NULL) {
+        capacity = LG_roundUpToPowerOfTwo(capacity);
+
+        lg->cells = LG_mallocOrExitWithError(sizeof(struct cell) * capacity);
+        lg->mask = capacity - 1;
+        lg->output = output;
+
+        for (size_t i = 0; i < capacity; i++)
+            atomic_init(&lg->cells[i].sequence, i);
+
+        atomic_init(&lg->pushPosition, 0);
+        atomic_init(&lg->popPosition, 0);
+        atomic_init(&lg->stopping, false);
+        atomic_init(&lg->dropped, 0);
+        sem_init(&lg->available, 0, 0);
+
+        //Signals are left to the thread that created the logger
+        sigset_t allSignals, previousSignals;
+        sigfillset(&allSignals);
+        pthread_sigmask(SIG_SETMASK, &allSignals, &previousSignals);
+
+        if (pthread_create(&lg->thread, NULL, LG_run, lg) != 0) {
+            fprintf(stderr, "Logger Error: Unable to create a thread\n");
+            exit(1);
+        }
+
+        pthread_sigmask(SIG_SETMASK, &previousSignals, NULL);
+    }
+
+    return lg;
+}
+
+void logger_free(Logger* lg) {
+    atomic_store(&lg->stopping, true);
+    sem_post(&lg->available);
+
+    pthread_join(lg->thread, NULL);
+
+    sem_destroy(&lg->available);
+    free(lg->cells);
+    free(lg);
+}
+
+bool logger_log(Logger* lg, const char* format, ...) {
+    size_t position;
+    struct cell* cell = LG_reserveCell(lg, &position);
+
+    if (cell == NULL) {
+        atomic_fetch_add(&lg->dropped, 1);
+        return false;
+    }
+
+    va_list args;
+    va_start(args, format);
+    const int written = vsnprintf(cell->line, LOGGER_LINE_MAX_SIZE, format, args);
+    va_end(args);
+
+    //Cut lines still end with a new line
+    if (written < 0) {
+        cell->lineSize = 0;
+    }
+    else if (written >= LOGGER_LINE_MAX_SIZE) {
+        cell->lineSize = LOGGER_LINE_MAX_SIZE - 1;
+        cell->line[LOGGER_LINE_MAX_SIZE - 2] = '\n';
+    }
+    else {
+        cell->lineSize = written;
+    }
+
+    atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+    sem_post(&lg->available);
+
+    return true;
+}
\ No newline at end of file
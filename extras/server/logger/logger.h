@@ -0,0 +1,24 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define LOGGER_LINE_MAX_SIZE 256
+
+/*
+    Lines are formatted by the caller into a bounded lock-free ring and written
+    by a background thread, so logging never waits for the output. Any number
+    of threads can log at the same time. The capacity is rounded up to a power of two.
+*/
+typedef struct logger Logger;
+
+Logger* logger_init(size_t capacity, FILE* output);
+//Writes the lines still in the ring before stopping
+void logger_free(Logger* lg);
+
+//Returns false (and drops the line) when the ring is full, longer lines are cut
+bool logger_log(Logger* lg, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+#endif
\ No newline at end of file
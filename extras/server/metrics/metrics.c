@@ -0,0 +1,570 @@
+#include "metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#define MT_SUB_BUCKETS_BITS 3
+#define MT_SUB_BUCKETS 8
+//Values under 8 have one bucket each, then 8 per power of two up to 2^64
+#define MT_BUCKETS_COUNT ((64 - MT_SUB_BUCKETS_BITS + 1) * MT_SUB_BUCKETS)
+//The Prometheus buckets go from 2^10 ns (~1us) to 2^36 ns (~69s)
+#define MT_FIRST_EXPORTED_POWER 10
+#define MT_LAST_EXPORTED_POWER 36
+//The ids of a shard are in segments of 32, 64, 128... that are never moved once allocated
+#define MT_FIRST_SEGMENT_BITS 5
+#define MT_SEGMENTS_COUNT (64 - MT_FIRST_SEGMENT_BITS)
+//Room for the le="..." or quantile="..." label after the labels of a metric
+#define MT_EXTRA_LABEL_MAX_SIZE 32
+
+enum MT_metricType {
+    MT_HISTOGRAM,
+    MT_COUNTER,
+    MT_GAUGE,
+};
+
+struct definition {
+    enum MT_metricType type;
+    size_t index;
+    char* name;
+    char* labels;
+    char* help;
+};
+
+/*
+    Only the owner thread writes its shard, so an update is a relaxed load and
+    store (no locked instruction), the atomics only make the reads of the
+    writer of the metrics well defined.
+*/
+struct histogram {
+    _Atomic uint64_t buckets[MT_BUCKETS_COUNT];
+    _Atomic uint64_t sum;
+    _Atomic uint64_t max;
+};
+
+/*
+    The segments are allocated by the owner on the first use of one of their ids
+    and then only read, so the writer of the metrics never sees one moved.
+*/
+struct shard {
+    pthread_t owner;
+    _Atomic(_Atomic(struct histogram*)*) histograms[MT_SEGMENTS_COUNT];
+    _Atomic(_Atomic int64_t*) counters[MT_SEGMENTS_COUNT];
+    struct shard* next;
+};
+
+struct metrics {
+    uint64_t id;
+    struct definition* definitions;
+    size_t definitionsCount;
+    size_t definitionsCapacity;
+    size_t histogramsCount;
+    size_t countersCount;
+    _Atomic(struct shard*) shards;
+};
+
+//The id tells apart a Metrics allocated where a freed one was
+static atomic_uint_fast64_t MT_nextId = 1;
+static _Thread_local uint64_t MT_cachedId = 0;
+static _Thread_local struct shard* MT_cachedShard = NULL;
+
+void* MT_mallocOrExitWithError(size_t size) {
+    void* m = malloc(size);
+
+    if (m == NULL) {
+        fprintf(stderr, "Metrics Error: Unable to allocate %lu bytes\n", size);
+        exit(1);
+    }
+
+    return m;
+}
+
+#pragma region SHARDS
+
+struct shard* MT_findOrAddShard(Metrics* m) {
+    const pthread_t self = pthread_self();
+    struct shard* head = atomic_load_explicit(&m->shards, memory_order_acquire);
+
+    for (struct shard* shard = head; shard != NULL; shard = shard->next) {
+        if (pthread_equal(shard->owner, self))
+            return shard;
+    }
+
+    struct shard* shard = MT_mallocOrExitWithError(sizeof(struct shard));
+    shard->owner = self;
+
+    for (size_t i = 0; i < MT_SEGMENTS_COUNT; i++) {
+        atomic_init(&shard->histograms[i], NULL);
+        atomic_init(&shard->counters[i], NULL);
+    }
+
+    //Only pushed, the shards live until the Metrics is freed
+    do {
+        shard->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&m->shards, &head, shard,
+                                                    memory_order_release, memory_order_acquire));
+
+    return shard;
+}
+
+static inline struct shard* MT_getShard(Metrics* m) {
+    if (MT_cachedId != m->id) {
+        MT_cachedShard = MT_findOrAddShard(m);
+        MT_cachedId = m->id;
+    }
+
+    return MT_cachedShard;
+}
+
+//The segment of the id and its index in it
+static inline size_t MT_getSegment(size_t id, size_t* index) {
+    const size_t n = id + ((size_t) 1 << MT_FIRST_SEGMENT_BITS);
+    const size_t segment = (63 - __builtin_clzll(n)) - MT_FIRST_SEGMENT_BITS;
+
+    *index = n - ((size_t) 1 << (segment + MT_FIRST_SEGMENT_BITS));
+
+    return segment;
+}
+
+static inline size_t MT_getSegmentSize(size_t segment) {
+    return (size_t) 1 << (segment + MT_FIRST_SEGMENT_BITS);
+}
+
+//The slot of the histogram in the shard, NULL if its segment isn't allocated and isn't created
+_Atomic(struct histogram*)* MT_getHistogramSlot(struct shard* shard, size_t histogram, bool create) {
+    size_t index;
+    const size_t segment = MT_getSegment(histogram, &index);
+    _Atomic(struct histogram*)* slots = atomic_load_explicit(&shard->histograms[segment], memory_order_acquire);
+
+    if (slots == NULL && create) {
+        slots = MT_mallocOrExitWithError(sizeof(*slots) * MT_getSegmentSize(segment));
+
+        for (size_t i = 0; i < MT_getSegmentSize(segment); i++)
+            atomic_init(&slots[i], NULL);
+
+        atomic_store_explicit(&shard->histograms[segment], slots, memory_order_release);
+    }
+
+    return slots != NULL ? &slots[index] : NULL;
+}
+
+_Atomic int64_t* MT_getCounterSlot(struct shard* shard, size_t counter, bool create) {
+    size_t index;
+    const size_t segment = MT_getSegment(counter, &index);
+    _Atomic int64_t* slots = atomic_load_explicit(&shard->counters[segment], memory_order_acquire);
+
+    if (slots == NULL && create) {
+        slots = MT_mallocOrExitWithError(sizeof(*slots) * MT_getSegmentSize(segment));
+
+        for (size_t i = 0; i < MT_getSegmentSize(segment); i++)
+            atomic_init(&slots[i], 0);
+
+        atomic_store_explicit(&shard->counters[segment], slots, memory_order_release);
+    }
+
+    return slots != NULL ? &slots[index] : NULL;
+}
+
+static inline void MT_increment(_Atomic uint64_t* value, uint64_t by) {
+    atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + by, memory_order_relaxed);
+}
+
+#pragma endregion
+
+#pragma region BUCKETS
+
+static inline size_t MT_getBucket(uint64_t value) {
+    if (value < MT_SUB_BUCKETS)
+        return value;
+
+    //The 3 bits after the highest one pick the sub bucket
+    const int power = 63 - __builtin_clzll(value);
+    const size_t subBucket = (value >> (power - MT_SUB_BUCKETS_BITS)) & (MT_SUB_BUCKETS - 1);
+
+    return (power - MT_SUB_BUCKETS_BITS + 1) * MT_SUB_BUCKETS + subBucket;
+}
+
+//Highest value of the bucket
+uint64_t MT_getBucketMax(size_t bucket) {
+    if (bucket < MT_SUB_BUCKETS)
+        return bucket;
+
+    const int shift = bucket / MT_SUB_BUCKETS - 1;
+    const uint64_t subBucket = bucket % MT_SUB_BUCKETS;
+
+    return ((MT_SUB_BUCKETS + subBucket + 1) << shift) - 1;
+}
+
+#pragma endregion
+
+#pragma region WRITER
+
+struct merged {
+    uint64_t buckets[MT_BUCKETS_COUNT];
+    uint64_t sum;
+    uint64_t max;
+};
+
+void MT_mergeHistogram(Metrics* m, size_t index, struct merged* merged) {
+    memset(merged, 0, sizeof(struct merged));
+
+    for (struct shard* shard = atomic_load_explicit(&m->shards, memory_order_acquire); shard != NULL; shard = shard->next) {
+        _Atomic(struct histogram*)* slot = MT_getHistogramSlot(shard, index, false);
+        struct histogram* h = slot != NULL ? atomic_load_explicit(slot, memory_order_acquire) : NULL;
+
+        if (h == NULL)
+            continue;
+
+        for (size_t i = 0; i < MT_BUCKETS_COUNT; i++)
+            merged->buckets[i] += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+
+        merged->sum += atomic_load_explicit(&h->sum, memory_order_relaxed);
+
+        const uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+        if (max > merged->max)
+            merged->max = max;
+    }
+}
+
+int64_t MT_mergeCounter(Metrics* m, size_t index) {
+    int64_t value = 0;
+
+    for (struct shard* shard = atomic_load_explicit(&m->shards, memory_order_acquire); shard != NULL; shard = shard->next) {
+        _Atomic int64_t* slot = MT_getCounterSlot(shard, index, false);
+
+        if (slot != NULL)
+            value += atomic_load_explicit(slot, memory_order_relaxed);
+    }
+
+    return value;
+}
+
+//The shards are updated while merged, so the count is the sum of the merged buckets (not a separate count)
+uint64_t MT_getQuantile(const struct merged* merged, uint64_t bucketsCount, double quantile) {
+    const uint64_t rank = (uint64_t) (quantile * bucketsCount + 0.5);
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < MT_BUCKETS_COUNT; i++) {
+        seen += merged->buckets[i];
+
+        if (seen >= rank && seen > 0)
+            return MT_getBucketMax(i) < merged->max ? MT_getBucketMax(i) : merged->max;
+    }
+
+    return merged->max;
+}
+
+void MT_writeLine(ResponseCreator* rc, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+//Written whole in the content, however long the labels are
+void MT_writeLine(ResponseCreator* rc, const char* format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    const int size = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    char* line = responseCreator_reserveBytes(rc, size + 1);
+
+    va_start(args, format);
+    vsnprintf(line, size + 1, format, args);
+    va_end(args);
+
+    responseCreator_commitBytes(rc, size);
+}
+
+//Fits the labels of the definition joined with an extra label
+static inline size_t MT_getJoinedLabelsSize(const struct definition* d) {
+    return strlen(d->labels) + MT_EXTRA_LABEL_MAX_SIZE + 3;
+}
+
+//"{labels,extra}", "{extra}" or "{labels}"
+void MT_joinLabels(char* out, size_t outSize, const char* labels, const char* extra) {
+    if (labels[0] != 0 && extra[0] != 0)
+        snprintf(out, outSize, "{%s,%s}", labels, extra);
+    else if (labels[0] != 0 || extra[0] != 0)
+        snprintf(out, outSize, "{%s}", labels[0] != 0 ? labels : extra);
+    else
+        out[0] = 0;
+}
+
+void MT_writeHistogram(Metrics* m, const struct definition* d, ResponseCreator* rc) {
+    struct merged* merged = MT_mallocOrExitWithError(sizeof(struct merged));
+    MT_mergeHistogram(m, d->index, merged);
+
+    const size_t labelsSize = MT_getJoinedLabelsSize(d);
+    char* labels = MT_mallocOrExitWithError(labelsSize);
+    char extra[MT_EXTRA_LABEL_MAX_SIZE];
+    uint64_t cumulative = 0;
+    size_t bucket = 0;
+
+    for (int power = MT_FIRST_EXPORTED_POWER; power <= MT_LAST_EXPORTED_POWER; power++) {
+        const size_t end = MT_getBucket((uint64_t) 1 << power);
+
+        for (; bucket < end; bucket++)
+            cumulative += merged->buckets[bucket];
+
+        snprintf(extra, sizeof(extra), "le=\"%.9g\"", (double) ((uint64_t) 1 << power) / 1e9);
+        MT_joinLabels(labels, labelsSize, d->labels, extra);
+        MT_writeLine(rc, "%s_bucket%s %lu\n", d->name, labels, cumulative);
+    }
+
+    for (; bucket < MT_BUCKETS_COUNT; bucket++)
+        cumulative += merged->buckets[bucket];
+
+    MT_joinLabels(labels, labelsSize, d->labels, "le=\"+Inf\"");
+    MT_writeLine(rc, "%s_bucket%s %lu\n", d->name, labels, cumulative);
+
+    MT_joinLabels(labels, labelsSize, d->labels, "");
+    MT_writeLine(rc, "%s_sum%s %.9f\n", d->name, labels, (double) merged->sum / 1e9);
+    MT_writeLine(rc, "%s_count%s %lu\n", d->name, labels, cumulative);
+
+    free(labels);
+    free(merged);
+}
+
+//The precise quantiles, that the Prometheus buckets (one per power of two) lose
+void MT_writeQuantiles(Metrics* m, const struct definition* d, ResponseCreator* rc) {
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+    struct merged* merged = MT_mallocOrExitWithError(sizeof(struct merged));
+    MT_mergeHistogram(m, d->index, merged);
+
+    uint64_t count = 0;
+    for (size_t i = 0; i < MT_BUCKETS_COUNT; i++)
+        count += merged->buckets[i];
+
+    const size_t labelsSize = MT_getJoinedLabelsSize(d);
+    char* labels = MT_mallocOrExitWithError(labelsSize);
+    char extra[MT_EXTRA_LABEL_MAX_SIZE];
+
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+        snprintf(extra, sizeof(extra), "quantile=\"%g\"", quantiles[i]);
+        MT_joinLabels(labels, labelsSize, d->labels, extra);
+        MT_writeLine(rc, "%s_quantile%s %.9f\n", d->name, labels,
+                     (double) MT_getQuantile(merged, count, quantiles[i]) / 1e9);
+    }
+
+    MT_joinLabels(labels, labelsSize, d->labels, "quantile=\"1\"");
+    MT_writeLine(rc, "%s_quantile%s %.9f\n", d->name, labels, (double) merged->max / 1e9);
+
+    free(labels);
+    free(merged);
+}
+
+const char* MT_getTypeName(enum MT_metricType type) {
+    if (type == MT_HISTOGRAM)
+        return "histogram";
+    else if (type == MT_COUNTER)
+        return "counter";
+    else
+        return "gauge";
+}
+
+#pragma endregion
+
+Metrics* metrics_init() {
+    Metrics* m = (Metrics*) malloc(sizeof(Metrics));
+
+    if (m != NULL) {
+        m->id = atomic_fetch_add(&MT_nextId, 1);
+        m->definitions = NULL;
+        m->definitionsCount = 0;
+        m->definitionsCapacity = 0;
+        m->histogramsCount = 0;
+        m->countersCount = 0;
+        atomic_init(&m->shards, NULL);
+    }
+
+    return m;
+}
+
+void metrics_free(Metrics* m) {
+    struct shard* shard = atomic_load(&m->shards);
+
+    while (shard != NULL) {
+        struct shard* next = shard->next;
+
+        for (size_t segment = 0; segment < MT_SEGMENTS_COUNT; segment++) {
+            _Atomic(struct histogram*)* histograms = atomic_load(&shard->histograms[segment]);
+
+            for (size_t i = 0; histograms != NULL && i < MT_getSegmentSize(segment); i++)
+                free(atomic_load(&histograms[i]));
+
+            free(histograms);
+            free(atomic_load(&shard->counters[segment]));
+        }
+
+        free(shard);
+        shard = next;
+    }
+
+    for (size_t i = 0; i < m->definitionsCount; i++) {
+        free(m->definitions[i].name);
+        free(m->definitions[i].labels);
+        free(m->definitions[i].help);
+    }
+
+    free(m->definitions);
+    free(m);
+}
+
+char* MT_copyString(const char* str) {
+    const size_t size = strlen(str) + 1;
+    char* copy = MT_mallocOrExitWithError(size);
+
+    memcpy(copy, str, size);
+
+    return copy;
+}
+
+size_t MT_addDefinition(Metrics* m, enum MT_metricType type, const char* name, const char* labels, const char* help) {
+    size_t* count = type == MT_HISTOGRAM ? &m->histogramsCount : &m->countersCount;
+
+    //Only added before the threads use the metrics, so they can be moved
+    if (m->definitionsCount == m->definitionsCapacity) {
+        m->definitionsCapacity = m->definitionsCapacity == 0 ? 16 : m->definitionsCapacity * 2;
+        m->definitions = realloc(m->definitions, sizeof(struct definition) * m->definitionsCapacity);
+
+        if (m->definitions == NULL) {
+            fprintf(stderr, "Metrics Error: Unable to allocate %lu definitions\n", m->definitionsCapacity);
+            exit(1);
+        }
+    }
+
+    struct definition* d = &m->definitions[m->definitionsCount++];
+    d->type = type;
+    d->index = (*count)++;
+
+    d->name = MT_copyString(name);
+    d->labels = MT_copyString(labels != NULL ? labels : "");
+    d->help = MT_copyString(help);
+
+    return d->index;
+}
+
+size_t metrics_addHistogram(Metrics* m, const char* name, const char* labels, const char* help) {
+    return MT_addDefinition(m, MT_HISTOGRAM, name, labels, help);
+}
+
+size_t metrics_addCounter(Metrics* m, const char* name, const char* labels, const char* help) {
+    return MT_addDefinition(m, MT_COUNTER, name, labels, help);
+}
+
+size_t metrics_addGauge(Metrics* m, const char* name, const char* labels, const char* help) {
+    return MT_addDefinition(m, MT_GAUGE, name, labels, help);
+}
+
+void metrics_escapeLabelValue(char* out, const char* value) {
+    for (; *value != 0; value++) {
+        if (*value == '\\' || *value == '"') {
+            *out++ = '\\';
+            *out++ = *value;
+        }
+        else if (*value == '\n') {
+            *out++ = '\\';
+            *out++ = 'n';
+        }
+        else {
+            *out++ = *value;
+        }
+    }
+
+    *out = 0;
+}
+
+uint64_t metrics_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void metrics_observe(Metrics* m, size_t histogram, uint64_t nanoseconds) {
+    _Atomic(struct histogram*)* slot = MT_getHistogramSlot(MT_getShard(m), histogram, true);
+    struct histogram* h = atomic_load_explicit(slot, memory_order_relaxed);
+
+    //Allocated on the first use, most threads only use some of them
+    if (h == NULL) {
+        h = MT_mallocOrExitWithError(sizeof(struct histogram));
+
+        for (size_t i = 0; i < MT_BUCKETS_COUNT; i++)
+            atomic_init(&h->buckets[i], 0);
+
+        atomic_init(&h->sum, 0);
+        atomic_init(&h->max, 0);
+
+        atomic_store_explicit(slot, h, memory_order_release);
+    }
+
+    MT_increment(&h->buckets[MT_getBucket(nanoseconds)], 1);
+    MT_increment(&h->sum, nanoseconds);
+
+    if (nanoseconds > atomic_load_explicit(&h->max, memory_order_relaxed))
+        atomic_store_explicit(&h->max, nanoseconds, memory_order_relaxed);
+}
+
+void metrics_add(Metrics* m, size_t counter, int64_t value) {
+    _Atomic int64_t* c = MT_getCounterSlot(MT_getShard(m), counter, true);
+
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+//Every metric of the name goes together, after the help and type of the name
+void MT_writeFamily(Metrics* m, size_t first, ResponseCreator* rc, bool isQuantiles) {
+    const struct definition* d = &m->definitions[first];
+
+    if (isQuantiles) {
+        MT_writeLine(rc, "# HELP %s_quantile %s (quantiles)\n", d->name, d->help);
+        MT_writeLine(rc, "# TYPE %s_quantile gauge\n", d->name);
+    }
+    else {
+        MT_writeLine(rc, "# HELP %s %s\n", d->name, d->help);
+        MT_writeLine(rc, "# TYPE %s %s\n", d->name, MT_getTypeName(d->type));
+    }
+
+    for (size_t i = first; i < m->definitionsCount; i++) {
+        const struct definition* same = &m->definitions[i];
+
+        if (strcmp(same->name, d->name) != 0)
+            continue;
+
+        if (same->type == MT_HISTOGRAM && isQuantiles) {
+            MT_writeQuantiles(m, same, rc);
+        }
+        else if (same->type == MT_HISTOGRAM) {
+            MT_writeHistogram(m, same, rc);
+        }
+        else {
+            const size_t labelsSize = MT_getJoinedLabelsSize(same);
+            char* labels = MT_mallocOrExitWithError(labelsSize);
+
+            MT_joinLabels(labels, labelsSize, same->labels, "");
+            MT_writeLine(rc, "%s%s %ld\n", same->name, labels, MT_mergeCounter(m, same->index));
+
+            free(labels);
+        }
+    }
+}
+
+void metrics_write(Metrics* m, ResponseCreator* rc) {
+    for (size_t i = 0; i < m->definitionsCount; i++) {
+        bool isFirstOfName = true;
+
+        for (size_t j = 0; j < i && isFirstOfName; j++)
+            isFirstOfName = strcmp(m->definitions[j].name, m->definitions[i].name) != 0;
+
+        if (!isFirstOfName)
+            continue;
+
+        MT_writeFamily(m, i, rc, false);
+
+        if (m->definitions[i].type == MT_HISTOGRAM)
+            MT_writeFamily(m, i, rc, true);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../responseCreator/responseCreator.h"
+
+/*
+    Counters, gauges and latency histograms that each thread updates in its own
+    shard (no locks and no shared cache lines), the shards are only merged when
+    the metrics are written. The histograms are HDR-style: 8 buckets per power
+    of two, so any duration is kept with 12.5% of precision.
+    The metrics are added before the threads start using them, by the id they return,
+    there is no limit on how many.
+*/
+typedef struct metrics Metrics;
+
+Metrics* metrics_init();
+void metrics_free(Metrics* m);
+
+//The labels ('route="/lexer"') can be NULL, metrics with the same name share the help
+size_t metrics_addHistogram(Metrics* m, const char* name, const char* labels, const char* help);
+size_t metrics_addCounter(Metrics* m, const char* name, const char* labels, const char* help);
+size_t metrics_addGauge(Metrics* m, const char* name, const char* labels, const char* help);
+
+//Writes the value with '\\', '"' and the new lines escaped, out must fit 2 * strlen(value) + 1 chars
+void metrics_escapeLabelValue(char* out, const char* value);
+
+//Monotonic time in nanoseconds, the unit of the histograms
+uint64_t metrics_now();
+
+void metrics_observe(Metrics* m, size_t histogram, uint64_t nanoseconds);
+//Also used by the gauges, with negative values
+void metrics_add(Metrics* m, size_t counter, int64_t value);
+
+//Prometheus text format, the histograms in seconds
+void metrics_write(Metrics* m, ResponseCreator* rc);
+
+#endif
\ No newline at end of file
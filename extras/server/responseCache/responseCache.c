@@ -0,0 +1,388 @@
+#include "responseCache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define RCA_INITIAL_BUCKETS 64
+
+/*
+    The entries are in a hash table (chained in the buckets) and in a list from
+    the most to the least recently used. An entry being copied to a response
+    has references, so if it is evicted meanwhile it is only freed by the last
+    reader, the copy itself is done out of the lock.
+    The hash isn't enough to tell the requests apart (collisions can be made on
+    purpose), so each entry keeps its request and a hit is only served when the
+    request is the same.
+*/
+struct entry {
+    uint64_t key;
+    enum content_type type;
+    char* request;
+    size_t requestSize;
+    char* content;
+    size_t size;
+    size_t references;
+    bool isEvicted;
+    struct entry* nextInBucket;
+    struct entry* prev;
+    struct entry* next;
+};
+
+struct responseCache {
+    pthread_mutex_t lock;
+    struct entry** buckets;
+    size_t bucketsCount;
+    struct entry* mostRecent;
+    struct entry* leastRecent;
+    ResponseCacheStats stats;
+};
+
+void* RCA_mallocOrExitWithError(size_t size) {
+    void* m = malloc(size);
+
+    if (m == NULL) {
+        fprintf(stderr, "Response Cache Error: Unable to allocate %lu bytes\n", size);
+        exit(1);
+    }
+
+    return m;
+}
+
+#pragma region HASH
+
+#define RCA_PRIME1 11400714785074694791ULL
+#define RCA_PRIME2 14029467366897019727ULL
+#define RCA_PRIME3 1609587929392839161ULL
+#define RCA_PRIME4 9650029242287828579ULL
+#define RCA_PRIME5 2870177450012600261ULL
+
+static inline uint64_t RCA_rotl(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t RCA_read64(const unsigned char* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+
+    return value;
+}
+
+static inline uint32_t RCA_read32(const unsigned char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+
+    return value;
+}
+
+static inline uint64_t RCA_round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * RCA_PRIME2;
+    accumulator = RCA_rotl(accumulator, 31);
+
+    return accumulator * RCA_PRIME1;
+}
+
+static inline uint64_t RCA_mergeRound(uint64_t accumulator, uint64_t value) {
+    accumulator ^= RCA_round(0, value);
+
+    return accumulator * RCA_PRIME1 + RCA_PRIME4;
+}
+
+//Reads in the host order, the hashes are only used inside this process
+uint64_t responseCache_hash(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* p = (const unsigned char*) data;
+    const unsigned char* end = p + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + RCA_PRIME1 + RCA_PRIME2;
+        uint64_t v2 = seed + RCA_PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - RCA_PRIME1;
+
+        for (; end - p >= 32; p += 32) {
+            v1 = RCA_round(v1, RCA_read64(p));
+            v2 = RCA_round(v2, RCA_read64(p + 8));
+            v3 = RCA_round(v3, RCA_read64(p + 16));
+            v4 = RCA_round(v4, RCA_read64(p + 24));
+        }
+
+        hash = RCA_rotl(v1, 1) + RCA_rotl(v2, 7) + RCA_rotl(v3, 12) + RCA_rotl(v4, 18);
+        hash = RCA_mergeRound(hash, v1);
+        hash = RCA_mergeRound(hash, v2);
+        hash = RCA_mergeRound(hash, v3);
+        hash = RCA_mergeRound(hash, v4);
+    }
+    else {
+        hash = seed + RCA_PRIME5;
+    }
+
+    hash += (uint64_t) size;
+
+    for (; end - p >= 8; p += 8) {
+        hash ^= RCA_round(0, RCA_read64(p));
+        hash = RCA_rotl(hash, 27) * RCA_PRIME1 + RCA_PRIME4;
+    }
+
+    if (end - p >= 4) {
+        hash ^= (uint64_t) RCA_read32(p) * RCA_PRIME1;
+        hash = RCA_rotl(hash, 23) * RCA_PRIME2 + RCA_PRIME3;
+        p += 4;
+    }
+
+    for (; p < end; p++) {
+        hash ^= (*p) * RCA_PRIME5;
+        hash = RCA_rotl(hash, 11) * RCA_PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= RCA_PRIME2;
+    hash ^= hash >> 29;
+    hash *= RCA_PRIME3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+#pragma endregion
+
+#pragma region LRU
+
+//Only the key, type and sizes are compared here, the request bytes are compared out of the lock
+struct entry* RCA_find(ResponseCache* rc, uint64_t key, size_t requestSize, enum content_type type) {
+    struct entry* e = rc->buckets[key & (rc->bucketsCount - 1)];
+
+    while (e != NULL && (e->key != key || e->requestSize != requestSize || e->type != type))
+        e = e->nextInBucket;
+
+    return e;
+}
+
+struct entry** RCA_findBucketLink(ResponseCache* rc, struct entry* e) {
+    struct entry** link = &rc->buckets[e->key & (rc->bucketsCount - 1)];
+
+    while (*link != e)
+        link = &(*link)->nextInBucket;
+
+    return link;
+}
+
+void RCA_unlinkRecent(ResponseCache* rc, struct entry* e) {
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        rc->mostRecent = e->next;
+
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    else
+        rc->leastRecent = e->prev;
+}
+
+void RCA_linkMostRecent(ResponseCache* rc, struct entry* e) {
+    e->prev = NULL;
+    e->next = rc->mostRecent;
+
+    if (rc->mostRecent != NULL)
+        rc->mostRecent->prev = e;
+    else
+        rc->leastRecent = e;
+
+    rc->mostRecent = e;
+}
+
+void RCA_freeEntry(struct entry* e) {
+    free(e->request);
+    free(e->content);
+    free(e);
+}
+
+void RCA_evict(ResponseCache* rc, struct entry* e) {
+    struct entry** link = RCA_findBucketLink(rc, e);
+    *link = e->nextInBucket;
+
+    RCA_unlinkRecent(rc, e);
+
+    rc->stats.entries--;
+    rc->stats.bytes -= e->requestSize + e->size;
+    rc->stats.evictions++;
+
+    //A reader still copying it frees it when done
+    e->isEvicted = true;
+
+    if (e->references == 0)
+        RCA_freeEntry(e);
+}
+
+void RCA_growBuckets(ResponseCache* rc) {
+    struct entry** oldBuckets = rc->buckets;
+    const size_t oldBucketsCount = rc->bucketsCount;
+
+    rc->bucketsCount *= 2;
+    rc->buckets = RCA_mallocOrExitWithError(sizeof(struct entry*) * rc->bucketsCount);
+    memset(rc->buckets, 0, sizeof(struct entry*) * rc->bucketsCount);
+
+    for (size_t i = 0; i < oldBucketsCount; i++) {
+        struct entry* e = oldBuckets[i];
+
+        while (e != NULL) {
+            struct entry* next = e->nextInBucket;
+            struct entry** bucket = &rc->buckets[e->key & (rc->bucketsCount - 1)];
+
+            e->nextInBucket = *bucket;
+            *bucket = e;
+
+            e = next;
+        }
+    }
+
+    free(oldBuckets);
+}
+
+#pragma endregion
+
+ResponseCache* responseCache_init(size_t byteBudget) {
+    ResponseCache* rc = (ResponseCache*) malloc(sizeof(ResponseCache));
+
+    if (rc != NULL) {
+        pthread_mutex_init(&rc->lock, NULL);
+
+        rc->bucketsCount = RCA_INITIAL_BUCKETS;
+        rc->buckets = RCA_mallocOrExitWithError(sizeof(struct entry*) * rc->bucketsCount);
+        memset(rc->buckets, 0, sizeof(struct entry*) * rc->bucketsCount);
+
+        rc->mostRecent = NULL;
+        rc->leastRecent = NULL;
+
+        memset(&rc->stats, 0, sizeof(rc->stats));
+        rc->stats.byteBudget = byteBudget;
+    }
+
+    return rc;
+}
+
+void responseCache_free(ResponseCache* rc) {
+    struct entry* e = rc->mostRecent;
+
+    while (e != NULL) {
+        struct entry* next = e->next;
+        RCA_freeEntry(e);
+        e = next;
+    }
+
+    pthread_mutex_destroy(&rc->lock);
+    free(rc->buckets);
+    free(rc);
+}
+
+ResponseCreator* responseCache_get(ResponseCache* rc, uint64_t key, const char* request, size_t requestSize,
+                                   enum content_type type) {
+
+    pthread_mutex_lock(&rc->lock);
+
+    struct entry* e = RCA_find(rc, key, requestSize, type);
+
+    if (e == NULL) {
+        rc->stats.misses++;
+        pthread_mutex_unlock(&rc->lock);
+
+        return NULL;
+    }
+
+    e->references++;
+
+    pthread_mutex_unlock(&rc->lock);
+
+    //A collision of the hash is a miss
+    const bool isSameRequest = memcmp(e->request, request, requestSize) == 0;
+    ResponseCreator* response = NULL;
+
+    if (isSameRequest) {
+        response = responseCreator_init(type, 200);
+        responseCreator_appendBytes(response, e->content, e->size);
+    }
+
+    pthread_mutex_lock(&rc->lock);
+
+    if (isSameRequest) {
+        rc->stats.hits++;
+
+        if (!e->isEvicted) {
+            RCA_unlinkRecent(rc, e);
+            RCA_linkMostRecent(rc, e);
+        }
+    }
+    else {
+        rc->stats.misses++;
+    }
+
+    e->references--;
+
+    if (e->isEvicted && e->references == 0)
+        RCA_freeEntry(e);
+
+    pthread_mutex_unlock(&rc->lock);
+
+    return response;
+}
+
+void responseCache_put(ResponseCache* rc, uint64_t key, const char* request, size_t requestSize,
+                       enum content_type type, const char* content, size_t size) {
+
+    const size_t entrySize = requestSize + size;
+
+    if (entrySize > rc->stats.byteBudget)
+        return;
+
+    //The copies are made before taking the lock
+    struct entry* e = RCA_mallocOrExitWithError(sizeof(struct entry));
+    e->request = RCA_mallocOrExitWithError(sizeof(char) * (requestSize > 0 ? requestSize : 1));
+    memcpy(e->request, request, requestSize);
+    e->content = RCA_mallocOrExitWithError(sizeof(char) * (size > 0 ? size : 1));
+    memcpy(e->content, content, size);
+
+    e->key = key;
+    e->type = type;
+    e->requestSize = requestSize;
+    e->size = size;
+    e->references = 0;
+    e->isEvicted = false;
+
+    pthread_mutex_lock(&rc->lock);
+
+    //Another thread put the same request first (or a colliding one has the place, then this one isn't cached)
+    struct entry* existing = RCA_find(rc, key, requestSize, type);
+
+    if (existing != NULL) {
+        pthread_mutex_unlock(&rc->lock);
+        RCA_freeEntry(e);
+
+        return;
+    }
+
+    while (rc->stats.bytes + entrySize > rc->stats.byteBudget)
+        RCA_evict(rc, rc->leastRecent);
+
+    if (rc->stats.entries + 1 > rc->bucketsCount)
+        RCA_growBuckets(rc);
+
+    struct entry** bucket = &rc->buckets[key & (rc->bucketsCount - 1)];
+    e->nextInBucket = *bucket;
+    *bucket = e;
+
+    RCA_linkMostRecent(rc, e);
+
+    rc->stats.entries++;
+    rc->stats.bytes += entrySize;
+
+    pthread_mutex_unlock(&rc->lock);
+}
+
+ResponseCacheStats responseCache_getStats(ResponseCache* rc) {
+    pthread_mutex_lock(&rc->lock);
+    const ResponseCacheStats stats = rc->stats;
+    pthread_mutex_unlock(&rc->lock);
+
+    return stats;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../responseCreator/responseCreator.h"
+
+/*
+    LRU cache of response contents keyed by a request (the body, or whatever
+    the response comes from) and the content type, found by a 64 bits hash of
+    them. The request is kept with the content and compared on each hit, and
+    both count in the byte budget: the least recently used ones are evicted
+    to keep them under it. Any number of threads can use it at the same time.
+*/
+typedef struct responseCache ResponseCache;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;
+    size_t bytes;
+    size_t byteBudget;
+} ResponseCacheStats;
+
+ResponseCache* responseCache_init(size_t byteBudget);
+void responseCache_free(ResponseCache* rc);
+
+//xxHash64
+uint64_t responseCache_hash(const void* data, size_t size, uint64_t seed);
+
+//A response (status 200) with a copy of the cached content, NULL (a miss) when it is not in the cache
+ResponseCreator* responseCache_get(ResponseCache* rc, uint64_t key, const char* request, size_t requestSize,
+                                   enum content_type type);
+//Copies the request and the content, they are not kept when they are bigger than the budget
+void responseCache_put(ResponseCache* rc, uint64_t key, const char* request, size_t requestSize,
+                       enum content_type type, const char* content, size_t size);
+
+ResponseCacheStats responseCache_getStats(ResponseCache* rc);
+
+#endif
\ No newline at end of file
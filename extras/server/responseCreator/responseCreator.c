@@ -5,16 +5,34 @@
 #include <stdint.h>
 #include <string.h>
 
-struct content {
-    char* str;
-    struct content *next;
-};
-
+#define RC_INITIAL_CONTENT_CAPACITY 4096
+#define RC_HEADER_MAX_SIZE 255
+#define RC_CHUNK_SIZE 65536
+
+//Fixed width chunk size ("%08lx\r\n"), so it can be written after the chunk is done
+#define RC_CHUNK_PREFIX_SIZE 10
+
+/*
+    The content is kept in one buffer that doubles when full and the header is
+    built apart, so the server sends both without joining them.
+    A stream response has no content of its own, each call to nextChunk empties
+    the buffer and calls the producer until the chunk is full or the stream ends.
+*/
 struct responseCreator {
     uint16_t statusCode;
     enum content_type contentType;
-    struct content *head;
+    char *content;
     size_t contentSize;
+    size_t contentCapacity;
+    bool keepAlive;
+    char header[RC_HEADER_MAX_SIZE];
+    size_t headerSize;
+    ResponseStreamProducer producer;
+    ResponseStreamFree freeStream;
+    void *stream;
+    bool isChunked;
+    bool isStreamOver;
+    bool isFlushRequested;
 };
 
 void* RC_mallocOrExitWithError(size_t size) {
@@ -37,58 +55,150 @@ ResponseCreator* responseCreator_init(enum content_type contentType,
         rc->contentType = contentType;
         rc->statusCode = statusCode;
         rc->contentSize = 0;
-        rc->head = NULL;
+        rc->contentCapacity = RC_INITIAL_CONTENT_CAPACITY;
+        rc->content = RC_mallocOrExitWithError(sizeof(char) * rc->contentCapacity);
+        rc->keepAlive = true;
+        rc->headerSize = 0;
+        rc->producer = NULL;
+        rc->freeStream = NULL;
+        rc->stream = NULL;
+        rc->isChunked = false;
+        rc->isStreamOver = false;
+        rc->isFlushRequested = false;
     }
 
     return rc;
 }
 
-void responseCreator_free(ResponseCreator* rc) {
-    struct content *no;
+ResponseCreator* responseCreator_initStream(enum content_type contentType, uint16_t statusCode,
+                                            ResponseStreamProducer producer, 
+                                            ResponseStreamFree freeStream, void *stream) {
 
-    while (rc->head != NULL) {
-        no = rc->head;
-        rc->head = rc->head->next;
+    ResponseCreator *rc = responseCreator_init(contentType, statusCode);
 
-        free(no->str);
-        free(no);
+    if (rc != NULL) {
+        rc->producer = producer;
+        rc->freeStream = freeStream;
+        rc->stream = stream;
+        rc->isChunked = true;
     }
 
+    return rc;
+}
+
+void responseCreator_free(ResponseCreator* rc) {
+    if (rc->freeStream != NULL)
+        rc->freeStream(rc->stream);
+
+    free(rc->content);
     free(rc);
 }
 
+char* responseCreator_reserveBytes(ResponseCreator *rc, size_t size) {
+    if (rc->contentSize + size > rc->contentCapacity) {
+        while (rc->contentSize + size > rc->contentCapacity)
+            rc->contentCapacity *= 2;
+
+        rc->content = realloc(rc->content, sizeof(char) * rc->contentCapacity);
+
+        if (rc->content == NULL) {
+            fprintf(stderr, "Response Creator Error: Unable to allocate %lu bytes\n", rc->contentCapacity);
+            exit(1);
+        }
+    }
+
+    return rc->content + rc->contentSize;
+}
+
+void responseCreator_commitBytes(ResponseCreator *rc, size_t size) {
+    rc->contentSize += size;
+}
+
+void responseCreator_appendBytes(ResponseCreator *rc, const void *data, size_t size) {
+    memcpy(responseCreator_reserveBytes(rc, size), data, size);
+    rc->contentSize += size;
+}
+
 void responseCreator_appendContent(ResponseCreator *rc, char *str) {
-    struct content *no = RC_mallocOrExitWithError(sizeof(struct content));
-    
-    const size_t strSize = strlen(str);
+    responseCreator_appendBytes(rc, str, strlen(str));
+}
 
-    char *strCopy = RC_mallocOrExitWithError(sizeof(char) * strSize + 1);
-    strcpy(strCopy, str);
+void responseCreator_setKeepAlive(ResponseCreator *rc, bool keepAlive) {
+    rc->keepAlive = keepAlive;
+}
 
-    rc->contentSize += strSize;
+void responseCreator_setChunked(ResponseCreator *rc, bool isChunked) {
+    rc->isChunked = isChunked && rc->producer != NULL;
+}
 
-    no->str = strCopy;
-    no->next = NULL;
+uint16_t responseCreator_getStatusCode(ResponseCreator *rc) {
+    return rc->statusCode;
+}
+
+enum content_type responseCreator_getContentType(ResponseCreator *rc) {
+    return rc->contentType;
+}
+
+bool responseCreator_isStream(ResponseCreator *rc) {
+    return rc->producer != NULL;
+}
+
+void responseCreator_flushChunk(ResponseCreator *rc) {
+    rc->isFlushRequested = true;
+}
+
+bool responseCreator_hasNextChunk(ResponseCreator *rc) {
+    return rc->producer != NULL && !rc->isStreamOver;
+}
+
+bool responseCreator_nextChunk(ResponseCreator *rc) {
+    if (rc->producer == NULL || rc->isStreamOver)
+        return false;
+
+    const size_t prefixSize = rc->isChunked ? RC_CHUNK_PREFIX_SIZE : 0;
+    rc->contentSize = prefixSize;
 
-    if (rc->head == NULL) {
-        rc->head = no;
+    rc->isFlushRequested = false;
+
+    while (rc->contentSize - prefixSize < RC_CHUNK_SIZE && !rc->isStreamOver && !rc->isFlushRequested)
+        rc->isStreamOver = !rc->producer(rc, rc->stream);
+
+    if (!rc->isChunked)
+        return true;
+
+    const size_t chunkSize = rc->contentSize - prefixSize;
+
+    //An empty chunk is the end of the body, so it is only written at the end
+    if (chunkSize == 0) {
+        rc->contentSize = 0;
     }
     else {
-        struct content *aux = rc->head;
+        //A producer can go past RC_CHUNK_SIZE in one call, but never to the 8 hex digits of the prefix
+        if (chunkSize > UINT32_MAX) {
+            fprintf(stderr, "Response Creator Error: Chunk of %lu bytes is too big\n", chunkSize);
+            exit(1);
+        }
 
-        while (aux->next != NULL)
-            aux = aux->next;
+        char prefix[RC_CHUNK_PREFIX_SIZE + 1];
+        snprintf(prefix, sizeof(prefix), "%08x\r\n", (uint32_t) chunkSize);
+        memcpy(rc->content, prefix, RC_CHUNK_PREFIX_SIZE);
 
-        aux->next = no;
+        responseCreator_appendBytes(rc, "\r\n", 2);
     }
+
+    if (rc->isStreamOver)
+        responseCreator_appendBytes(rc, "0\r\n\r\n", 5);
+
+    return true;
 }
 
-char* responseCreator_getResponse(ResponseCreator *rc) {
+const char* responseCreator_getHeader(ResponseCreator *rc, size_t *size) {
     const char *headerTemplate = 
         "HTTP/1.1 %u %s\r\n"
         "Server: Integrated Compiler Server\r\n"
         "Content-Type: %s\r\n"
-        "Connection: Closed\r\n"
+        "%s%s"
+        "Connection: %s\r\n"
         "Access-Control-Allow-Origin: *\r\n"
         "\r\n";
 
@@ -97,38 +207,42 @@ char* responseCreator_getResponse(ResponseCreator *rc) {
         contentType = "text/html";
     else if (rc->contentType == TYPE_JSON)
         contentType = "application/json";
+    else if (rc->contentType == TYPE_BINARY)
+        contentType = "application/octet-stream";
+    else if (rc->contentType == TYPE_TEXT)
+        contentType = "text/plain; version=0.0.4";
     else
         contentType = "plain/text";
 
     const char* statusCodeInfo;
     if (rc->statusCode == 404)
         statusCodeInfo = "NOT FOUND";
+    else if (rc->statusCode == 400)
+        statusCodeInfo = "BAD REQUEST";
+    else if (rc->statusCode == 413)
+        statusCodeInfo = "PAYLOAD TOO LARGE";
     else
         statusCodeInfo = "OK";
 
-    char headerStr[255];
-    sprintf(headerStr, headerTemplate, rc->statusCode, statusCodeInfo, contentType);
+    //A stream without chunks is over when the connection is closed
+    char contentLength[64] = "";
+    const char *transferEncoding = "";
 
-    char *contentStr = RC_mallocOrExitWithError(sizeof(char) * rc->contentSize + 3);
-    memset(contentStr, 0, sizeof(char) * rc->contentSize + 3);
+    if (rc->producer == NULL)
+        sprintf(contentLength, "Content-Length: %lu\r\n", rc->contentSize);
+    else if (rc->isChunked)
+        transferEncoding = "Transfer-Encoding: chunked\r\n";
 
-    struct content *no = rc->head;
-    
-    while (no != NULL) {
-        strcat(contentStr, no->str);
-        no = no->next;
-    }
+    rc->headerSize = snprintf(rc->header, RC_HEADER_MAX_SIZE, headerTemplate, rc->statusCode,
+        statusCodeInfo, contentType, contentLength, transferEncoding, rc->keepAlive ? "keep-alive" : "close");
 
-    strcat(contentStr, "\r\n");
+    *size = rc->headerSize;
 
-    const size_t responseSize = strlen(headerStr) + strlen(contentStr) + 1;
-    char *responseStr = RC_mallocOrExitWithError(sizeof(char) * responseSize);
-    memset(responseStr, 0, sizeof(char) * responseSize);
-
-    strncpy(responseStr, headerStr, strlen(headerStr));
-    strcat(responseStr, contentStr);
+    return rc->header;
+}
 
-    free(contentStr);
+const char* responseCreator_getContent(ResponseCreator *rc, size_t *size) {
+    *size = rc->contentSize;
 
-    return responseStr;
+    return rc->content;
 }
\ No newline at end of file
@@ -2,20 +2,48 @@
 #define RESPONSE_CREATOR_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 enum content_type {
     TYPE_HTML,
     TYPE_JSON,
+    TYPE_BINARY,
+    TYPE_TEXT,
 };
 
 typedef struct responseCreator ResponseCreator;
 
+//Appends the next part of the content, returns false when there is nothing more
+typedef bool (*ResponseStreamProducer)(ResponseCreator *rc, void *stream);
+typedef void (*ResponseStreamFree)(void *stream);
+
 ResponseCreator* responseCreator_init(enum content_type contentType, 
                                       uint16_t statusCode);
+ResponseCreator* responseCreator_initStream(enum content_type contentType, uint16_t statusCode,
+                                            ResponseStreamProducer producer, 
+                                            ResponseStreamFree freeStream, void *stream);
 void responseCreator_free(ResponseCreator* rc);
 
 void responseCreator_appendContent(ResponseCreator *rc, char *str);
+void responseCreator_appendBytes(ResponseCreator *rc, const void *data, size_t size);
+
+//Room for size bytes at the end of the content to be written in place, commit what was written
+char* responseCreator_reserveBytes(ResponseCreator *rc, size_t size);
+void responseCreator_commitBytes(ResponseCreator *rc, size_t size);
+
+void responseCreator_setKeepAlive(ResponseCreator *rc, bool keepAlive);
+void responseCreator_setChunked(ResponseCreator *rc, bool isChunked);
+//Called by a producer, the chunk is sent after this call even if it isn't full
+void responseCreator_flushChunk(ResponseCreator *rc);
+
+uint16_t responseCreator_getStatusCode(ResponseCreator *rc);
+enum content_type responseCreator_getContentType(ResponseCreator *rc);
+bool responseCreator_isStream(ResponseCreator *rc);
+bool responseCreator_hasNextChunk(ResponseCreator *rc);
+bool responseCreator_nextChunk(ResponseCreator *rc);
 
-char* responseCreator_getResponse(ResponseCreator *rc);
+const char* responseCreator_getHeader(ResponseCreator *rc, size_t *size);
+const char* responseCreator_getContent(ResponseCreator *rc, size_t *size);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "router.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define RT_INITIAL_CAPACITY 16
+
+//FNV-1a
+#define RT_HASH_INIT 14695981039346656037ULL
+#define RT_HASH_PRIME 1099511628211ULL
+
+struct route {
+    enum http_method method;
+    char* path;
+    size_t pathLen;
+    uint64_t hash;
+    size_t index;
+    RouteCallback callback;
+};
+
+//Open addressing with linear probing, kept under 3/4 full
+struct router {
+    struct route* slots;
+    size_t capacity;
+    size_t size;
+};
+
+void* RT_mallocOrExitWithError(size_t size) {
+    void* m = malloc(size);
+
+    if (m == NULL) {
+        fprintf(stderr, "Router Error: Unable to allocate %lu bytes\n", size);
+        exit(1);
+    }
+
+    return m;
+}
+
+uint64_t RT_hash(enum http_method method, const char* path, size_t pathLen) {
+    uint64_t hash = (RT_HASH_INIT ^ (uint64_t) method) * RT_HASH_PRIME;
+
+    for (size_t i = 0; i < pathLen; i++)
+        hash = (hash ^ (unsigned char) path[i]) * RT_HASH_PRIME;
+
+    return hash;
+}
+
+struct route* RT_allocSlots(size_t capacity) {
+    struct route* slots = RT_mallocOrExitWithError(sizeof(struct route) * capacity);
+
+    //An empty slot has no path
+    for (size_t i = 0; i < capacity; i++)
+        slots[i].path = NULL;
+
+    return slots;
+}
+
+struct route* RT_findSlot(Router* r, enum http_method method, const char* path, size_t pathLen, uint64_t hash) {
+    const size_t mask = r->capacity - 1;
+    size_t i = hash & mask;
+
+    while (r->slots[i].path != NULL) {
+        const struct route* route = &r->slots[i];
+
+        if (route->hash == hash && route->method == method && route->pathLen == pathLen &&
+            memcmp(route->path, path, pathLen) == 0)
+            break;
+
+        i = (i + 1) & mask;
+    }
+
+    return &r->slots[i];
+}
+
+void RT_grow(Router* r) {
+    struct route* oldSlots = r->slots;
+    const size_t oldCapacity = r->capacity;
+
+    r->capacity *= 2;
+    r->slots = RT_allocSlots(r->capacity);
+
+    for (size_t i = 0; i < oldCapacity; i++) {
+        if (oldSlots[i].path != NULL) {
+            const struct route route = oldSlots[i];
+            *RT_findSlot(r, route.method, route.path, route.pathLen, route.hash) = route;
+        }
+    }
+
+    free(oldSlots);
+}
+
+Router* router_init() {
+    Router* r = (Router*) malloc(sizeof(Router));
+
+    if (r != NULL) {
+        r->capacity = RT_INITIAL_CAPACITY;
+        r->size = 0;
+        r->slots = RT_allocSlots(r->capacity);
+    }
+
+    return r;
+}
+
+void router_free(Router* r) {
+    for (size_t i = 0; i < r->capacity; i++)
+        free(r->slots[i].path);
+
+    free(r->slots);
+    free(r);
+}
+
+void router_add(Router* r, enum http_method method, const char* path, RouteCallback callback) {
+    if ((r->size + 1) * 4 > r->capacity * 3)
+        RT_grow(r);
+
+    const size_t pathLen = strlen(path);
+    const uint64_t hash = RT_hash(method, path, pathLen);
+    struct route* slot = RT_findSlot(r, method, path, pathLen, hash);
+
+    if (slot->path == NULL) {
+        slot->path = RT_mallocOrExitWithError(sizeof(char) * (pathLen + 1));
+        memcpy(slot->path, path, pathLen + 1);
+
+        slot->method = method;
+        slot->pathLen = pathLen;
+        slot->hash = hash;
+        slot->index = r->size;
+
+        r->size++;
+    }
+
+    slot->callback = callback;
+}
+
+RouteCallback router_find(Router* r, enum http_method method, StringView path, size_t* index) {
+    const uint64_t hash = RT_hash(method, path.data, path.size);
+    const struct route* slot = RT_findSlot(r, method, path.data, path.size, hash);
+
+    if (slot->path == NULL)
+        return NULL;
+
+    *index = slot->index;
+
+    return slot->callback;
+}
+
+size_t router_getSize(Router* r) {
+    return r->size;
+}
\ No newline at end of file
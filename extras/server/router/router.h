@@ -0,0 +1,23 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <stddef.h>
+
+#include "../server.h"
+
+/*
+    Hash table of routes keyed by (method, path), it grows with the routes so
+    finding one is only hashing the path, however many routes there are.
+*/
+typedef struct router Router;
+
+Router* router_init();
+void router_free(Router* r);
+
+//Adding the same method and path again replaces the callback (and keeps the index)
+void router_add(Router* r, enum http_method method, const char* path, RouteCallback callback);
+//NULL when there is no route, the index is the order the route was added in (from 0)
+RouteCallback router_find(Router* r, enum http_method method, StringView path, size_t* index);
+size_t router_getSize(Router* r);
+
+#endif
\ No newline at end of file
@@ -2,32 +2,143 @@
 
 #include <stdio.h>
 #include <stdint.h>
-#include <netdb.h>
 #include <netinet/in.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <time.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
+#include "threadPool/threadPool.h"
+#include "workQueue/workQueue.h"
+#include "logger/logger.h"
+#include "router/router.h"
+#include "metrics/metrics.h"
+#include "webSocket/webSocket.h"
+
 #define REQUEST_MAX_SIZE 1000000
-#define ROUTES_MAX_SIZE 2
 #define SA struct sockaddr
 
-typedef struct {
-    const char* path;
-    enum http_method method;
-    RouteCallback callback;
-} Route;
+#define SV_MAX_EVENTS 256
+#define SV_READ_CHUNK_SIZE 16384
+#define SV_INITIAL_BUFFER_SIZE 4096
+#define SV_LISTEN_BACKLOG 1024
+#define SV_JOBS_QUEUE_SIZE 1024
+#define SV_MAX_REQUESTS_PER_CONNECTION 100
+#define SV_IDLE_TIMEOUT 5
+#define SV_WEB_SOCKET_IDLE_TIMEOUT 300
+#define SV_SWEEP_INTERVAL 1000
+#define SV_LOG_CAPACITY 4096
+//"255.255.255.255:65535"
+#define SV_ADDRESS_MAX_SIZE (INET_ADDRSTRLEN + 6)
+//The 101 response of the upgrade, also where the frame headers are written
+#define SV_UPGRADE_HEADER_MAX_SIZE 256
+
+//What the server keeps of each route, by the index of the route in the router
+struct SV_route {
+    size_t callbackHistogram;
+    bool isWebSocket;
+    WebSocketHandlers handlers;
+};
+
+enum SV_connectionState {
+    SV_READING,
+    SV_PROCESSING,
+    SV_WRITING,
+    SV_DRAINING,
+};
 
+/*
+    State of one client, the request is read into the buffer (it can arrive in
+    many reads) and the response is written from the response offset (it can
+    take many writes), each time epoll says the socket is ready again.
+    While a worker builds the response (SV_PROCESSING) only that worker touches it.
+    The connection is kept alive after the response, the bytes after the request
+    (pipelined requests) stay in the buffer and are handled one at a time, in order.
+    After a WebSocket upgrade the same steps read one frame and write its reply:
+    the frame header is the headersSize and its payload the contentLength.
+*/
+typedef struct connection {
+    int fd;
+    enum SV_connectionState state;
+    char* buffer;
+    size_t bufferSize;
+    size_t bufferCapacity;
+    size_t scannedSize;
+    size_t headersSize;
+    size_t contentLength;
+    size_t pathOffset;
+    size_t pathSize;
+    size_t querySize;
+    size_t headersOffset;
+    size_t requestsCount;
+    bool keepAlive;
+    bool isHttp10;
+    //Status of a request refused while parsing (0 when valid), it is answered without its content
+    uint16_t errorStatus;
+    time_t lastActivity;
+    Request request;
+    ResponseCreator *response;
+    struct iovec responseParts[2];
+    size_t responseSize;
+    size_t responseSent;
+    size_t responseTotalSent;
+    uint64_t parseTime;
+    uint64_t buildTime;
+    uint64_t writeTime;
+    char address[SV_ADDRESS_MAX_SIZE];
+    //Set by the worker of the upgrade, the frames are read after its response is written
+    const struct SV_route *webSocket;
+    void *webSocketState;
+    bool isWebSocket;
+    WebSocketFrame frame;
+    char upgradeHeader[SV_UPGRADE_HEADER_MAX_SIZE];
+    struct connection *prev;
+    struct connection *next;
+    struct connection *nextPending;
+} Connection;
+
+/*
+    The thread of server_start owns the sockets, the workers only run the route
+    callbacks: a complete request goes to the pool and the connection comes back
+    through the done queue, with the eventfd waking up epoll.
+*/
 struct server {
     int sockfd;
-    int connfd;
-    Route routes[ROUTES_MAX_SIZE];
-    size_t routesPtr;
+    int epollfd;
+    int wakefd;
+    Connection *connections;
+    Connection *closed;
+    Connection *pendingHead;
+    Connection *pendingTail;
+    ThreadPool *workers;
+    size_t threadsCount;
+    WorkQueue *done;
+    //Submitted and not popped from the done queue yet, never more than it holds
+    size_t inFlight;
+    bool isAccessLogEnabled;
+    Logger *logger;
+    time_t lastSweep;
+    Router *router;
+    Metrics *metrics;
+    struct SV_route *routes;
+    size_t routesCount;
+    size_t parseHistogram;
+    size_t buildHistogram;
+    size_t writeHistogram;
+    size_t bytesInCounter;
+    size_t bytesOutCounter;
+    size_t connectionsGauge;
     uint16_t port;
 };
 
@@ -40,131 +151,888 @@ struct server {
         - https://www.tutorialspoint.com/http/http_responses.htm
 */
 
-enum http_method SV_getRequestHttpMethod(char request[REQUEST_MAX_SIZE], size_t *requestPtr) {
-    size_t methodLen = 0;
-    
-    *requestPtr = 0;
+bool SV_isWebSocketUpgrade(Request request) {
+    const StringView upgrade = server_getHeader(request, "Upgrade");
+    const StringView key = server_getHeader(request, "Sec-WebSocket-Key");
 
-    while (request[*requestPtr + methodLen] != ' ')
-        methodLen++;
+    return request.method == HTTP_GET && key.size > 0 &&
+           upgrade.size == 9 && strncasecmp(upgrade.data, "websocket", 9) == 0;
+}
+
+//The response of the upgrade has no content, its header is written apart (in the connection)
+ResponseCreator* SV_upgradeToWebSocket(Connection *c, const struct SV_route *route) {
+    char acceptKey[WEB_SOCKET_ACCEPT_KEY_SIZE + 1];
+    const StringView key = server_getHeader(c->request, "Sec-WebSocket-Key");
+
+    webSocket_getAcceptKey(key.data, key.size, acceptKey);
 
-    const size_t mallocSize = sizeof(char) * methodLen + 1;
-    char *strMethod = malloc(mallocSize);
-    memset(strMethod, 0, mallocSize);
+    snprintf(c->upgradeHeader, SV_UPGRADE_HEADER_MAX_SIZE,
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Server: Integrated Compiler Server\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: %s\r\n"
+        "\r\n", acceptKey);
 
-    strncpy(strMethod, request, methodLen);
+    c->webSocket = route;
+    c->webSocketState = route->handlers.open(c->request);
+    c->keepAlive = true;
+
+    return responseCreator_init(TYPE_BINARY, 101);
+}
 
-    enum http_method method;
+ResponseCreator* SV_solveRouteAndGetResponse(Server *s, Connection *c) {
+    size_t routeIndex;
+    const RouteCallback callback = router_find(s->router, c->request.method, c->request.path, &routeIndex);
+    ResponseCreator* rc;
 
-    if (strcmp("GET", strMethod) == 0)
-        method = HTTP_GET;
-    else if (strcmp("POST", strMethod) == 0)
-        method = HTTP_POST;
+    if (c->errorStatus != 0) {
+        rc = responseCreator_init(TYPE_JSON, c->errorStatus);
+    }
+    else if (callback != NULL && s->routes[routeIndex].isWebSocket && SV_isWebSocketUpgrade(c->request)) {
+        return SV_upgradeToWebSocket(c, &s->routes[routeIndex]);
+    }
+    else if (callback != NULL) {
+        const uint64_t start = metrics_now();
+        rc = callback(c->request);
+        metrics_observe(s->metrics, s->routes[routeIndex].callbackHistogram, metrics_now() - start);
+    }
     else
-        method = HTTP_OTHER;
+        rc = responseCreator_init(TYPE_JSON, 404);
 
-    free(strMethod);
-    *requestPtr = methodLen + 1;
+    responseCreator_setKeepAlive(rc, c->keepAlive);
 
-    return method;
+    return rc;
 }
 
-char* SV_getRequestPath(char request[REQUEST_MAX_SIZE], size_t *requestPtr) {
-    size_t routeLen = 0;
+void* SV_mallocOrExitWithError(size_t size) {
+    void* m = malloc(size);
 
-    while (request[*requestPtr + routeLen] != ' ')
-        routeLen++;
+    if (m == NULL) {
+        fprintf(stderr, "Server Error: Unable to allocate %lu bytes\n", size);
+        exit(1);
+    }
 
-    const size_t mallocSize = sizeof(char) * routeLen + 1;
-    char *route = malloc(mallocSize);
-    memset(route, 0, mallocSize);
+    return m;
+}
 
-    strncpy(route, request + *requestPtr, routeLen);
+time_t SV_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
-    return route;
+    return now.tv_sec;
 }
 
-char* SV_getRequestContent(char request[REQUEST_MAX_SIZE], size_t requestLen) {
-    char *contentStart = strstr(request, "\r\n\r\n");
-    contentStart = contentStart + 4;
+void SV_setNonBlockingOrExitWithError(int fd) {
+    const int flags = fcntl(fd, F_GETFL, 0);
+
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        fprintf(stderr, "Server Error => server_start: Unable to set socket as non blocking\n");
+        exit(1);
+    }
+}
 
-    const size_t contentLen = requestLen - (contentStart - request);
-    const size_t mallocSize = sizeof(char) * contentLen + 1;
+Connection* SV_openConnection(Server *s, int fd) {
+    Connection *c = SV_mallocOrExitWithError(sizeof(Connection));
+
+    c->fd = fd;
+    c->state = SV_READING;
+
+    c->bufferSize = 0;
+    c->bufferCapacity = SV_INITIAL_BUFFER_SIZE;
+    c->buffer = SV_mallocOrExitWithError(sizeof(char) * (c->bufferCapacity + 1));
+    c->buffer[0] = 0;
+
+    c->scannedSize = 0;
+    c->headersSize = 0;
+    c->contentLength = 0;
+    c->requestsCount = 0;
+    c->keepAlive = true;
+    c->isHttp10 = false;
+    c->errorStatus = 0;
+    c->lastActivity = SV_now();
+
+    c->response = NULL;
+    c->responseSize = 0;
+    c->responseSent = 0;
+    c->responseTotalSent = 0;
+    c->parseTime = 0;
+    c->buildTime = 0;
+    c->writeTime = 0;
+    c->address[0] = 0;
+
+    c->webSocket = NULL;
+    c->webSocketState = NULL;
+    c->isWebSocket = false;
+
+    c->nextPending = NULL;
+    c->prev = NULL;
+    c->next = s->connections;
+
+    if (s->connections != NULL)
+        s->connections->prev = c;
+
+    s->connections = c;
+
+    //Edge triggered, each event has to be handled until read or write would block
+    struct epoll_event event = {
+        .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+        .data.ptr = c,
+    };
 
-    char *content = malloc(mallocSize);
-    memset(content, 0, mallocSize);
+    if (epoll_ctl(s->epollfd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        fprintf(stderr, "Server Error => server_start: Unable to watch the connection\n");
+        exit(1);
+    }
 
-    strcpy(content, contentStart);
+    metrics_add(s->metrics, s->connectionsGauge, 1);
 
-    return content;
+    return c;
 }
 
-Request SV_parseRequest(Server *s) {
-    char buff[REQUEST_MAX_SIZE];
-    memset(buff, 0, REQUEST_MAX_SIZE);
+void SV_closeConnection(Server *s, Connection *c) {
+    //Closing the socket also removes it from the epoll set
+    close(c->fd);
+    c->fd = -1;
 
-    int connfd = s->connfd;
+    if (c->prev != NULL)
+        c->prev->next = c->next;
+    else
+        s->connections = c->next;
 
-    ssize_t t = read(connfd, buff, sizeof(buff));
-    size_t requestPtr = 0;
+    if (c->next != NULL)
+        c->next->prev = c->prev;
 
-    Request request;
+    metrics_add(s->metrics, s->connectionsGauge, -1);
+
+    //Other events of the same epoll_wait can still point to it, so it is freed later
+    c->nextPending = s->closed;
+    s->closed = c;
+}
+
+void SV_freeClosedConnections(Server *s) {
+    while (s->closed != NULL) {
+        Connection *c = s->closed;
+        s->closed = c->nextPending;
+
+        free(c->buffer);
+        if (c->response != NULL)
+            responseCreator_free(c->response);
+
+        if (c->webSocket != NULL)
+            c->webSocket->handlers.close(c->webSocketState);
+
+        free(c);
+    }
+}
+
+//Position of the "\r\n\r\n" that ends the headers, NULL when it is not in the range
+const char* SV_findHeadersEnd(const char *from, const char *to) {
+    while ((from = memchr(from, '\r', to - from)) != NULL) {
+        if (to - from < 4)
+            return NULL;
+
+        if (memcmp(from, "\r\n\r\n", 4) == 0)
+            return from;
+
+        from++;
+    }
+
+    return NULL;
+}
+
+enum http_method SV_getHttpMethod(const char *method, size_t methodLen) {
+    if (methodLen == 3 && memcmp(method, "GET", 3) == 0)
+        return HTTP_GET;
+    else if (methodLen == 4 && memcmp(method, "POST", 4) == 0)
+        return HTTP_POST;
+    else
+        return HTTP_OTHER;
+}
+
+bool SV_isHeader(const char *line, size_t lineLen, const char *name) {
+    const size_t nameLen = strlen(name);
+
+    return lineLen > nameLen && line[nameLen] == ':' && strncasecmp(line, name, nameLen) == 0;
+}
+
+void SV_parseRequestLine(Connection *c, const char *lineEnd) {
+    const char *method = c->buffer;
+    const char *methodEnd = memchr(method, ' ', lineEnd - method);
+
+    if (methodEnd == NULL)
+        methodEnd = lineEnd;
+
+    const char *path = methodEnd < lineEnd ? methodEnd + 1 : lineEnd;
+    const char *pathEnd = memchr(path, ' ', lineEnd - path);
+
+    if (pathEnd == NULL)
+        pathEnd = lineEnd;
+
+    c->request.method = SV_getHttpMethod(method, methodEnd - method);
+
+    const char *query = memchr(path, '?', pathEnd - path);
+
+    //Only offsets, the buffer can still move while the content is read
+    c->pathOffset = path - c->buffer;
+    c->pathSize = (query != NULL ? query : pathEnd) - path;
+    c->querySize = query != NULL ? pathEnd - query - 1 : 0;
+    c->headersOffset = lineEnd + 2 - c->buffer;
+
+    //HTTP/1.1 keeps the connection by default, HTTP/1.0 only when asked
+    c->isHttp10 = lineEnd - pathEnd == 9 && memcmp(pathEnd + 1, "HTTP/1.0", 8) == 0;
+    c->keepAlive = !c->isHttp10;
+}
+
+void SV_parseHeader(Connection *c, const char *line, const char *lineEnd) {
+    const size_t lineLen = lineEnd - line;
+    const char *value;
+
+    if (SV_isHeader(line, lineLen, "Content-Length")) {
+        value = line + 15;
+        c->contentLength = 0;
+
+        while (value < lineEnd && (*value == ' ' || *value == '\t'))
+            value++;
+
+        const char *digits = value;
+
+        //Stops as soon as it is too big, so the size never overflows
+        for (; value < lineEnd && *value >= '0' && *value <= '9' && c->contentLength <= REQUEST_MAX_SIZE; value++)
+            c->contentLength = c->contentLength * 10 + (*value - '0');
+
+        while (value < lineEnd && (*value == ' ' || *value == '\t'))
+            value++;
+
+        if (c->contentLength > REQUEST_MAX_SIZE)
+            c->errorStatus = 413;
+        else if (value == digits || value < lineEnd)
+            c->errorStatus = 400;
+    }
+    else if (SV_isHeader(line, lineLen, "Connection")) {
+        value = line + 11;
+
+        while (value < lineEnd && (*value == ' ' || *value == '\t'))
+            value++;
+
+        if (lineEnd - value >= 5 && strncasecmp(value, "close", 5) == 0)
+            c->keepAlive = false;
+        else if (lineEnd - value >= 10 && strncasecmp(value, "keep-alive", 10) == 0)
+            c->keepAlive = true;
+    }
+}
+
+/*
+    Incremental parser: each call only searches the bytes that arrived since the
+    last one for the end of the headers, and the request line and the headers
+    are parsed once, when they are complete. Nothing is copied, the Request views
+    point into the connection buffer.
+*/
+bool SV_parseHeaders(Connection *c) {
+    if (c->headersSize > 0)
+        return true;
+
+    //The end of the headers can start in the last 3 bytes already searched
+    const size_t from = c->scannedSize > 3 ? c->scannedSize - 3 : 0;
+    const char *bufferEnd = c->buffer + c->bufferSize;
+    const char *headersEnd = SV_findHeadersEnd(c->buffer + from, bufferEnd);
+
+    if (headersEnd == NULL) {
+        c->scannedSize = c->bufferSize;
+        return false;
+    }
+
+    c->headersSize = headersEnd + 4 - c->buffer;
+
+    //Without Content-Length the request is over at the end of the headers
+    c->contentLength = 0;
+
+    const char *line = c->buffer;
+    const char *lineEnd = memchr(line, '\r', headersEnd + 2 - line);
+
+    SV_parseRequestLine(c, lineEnd);
+
+    while (lineEnd < headersEnd) {
+        line = lineEnd + 2;
+        lineEnd = memchr(line, '\r', headersEnd + 2 - line);
+
+        SV_parseHeader(c, line, lineEnd);
+    }
 
-    request.method = SV_getRequestHttpMethod(buff, &requestPtr);
-    request.path = SV_getRequestPath(buff, &requestPtr);
-    request.content = SV_getRequestContent(buff, t);
+    //Where a refused request ends isn't known, so nothing after its headers is read
+    if (c->errorStatus != 0) {
+        c->contentLength = 0;
+        c->keepAlive = false;
+    }
 
-    return request;
+    return true;
 }
 
-void SV_freeRequest(Request request) {
-    free(request.path);
-    free(request.content);
+//Only the header of the frame, its payload is read as the content of a request
+bool SV_parseFrame(Connection *c) {
+    if (c->headersSize > 0)
+        return true;
+
+    if (!webSocket_parseFrameHeader(c->buffer, c->bufferSize, &c->frame))
+        return false;
+
+    c->headersSize = c->frame.headerSize;
+
+    //Too big frames are refused as too big requests, without overflowing the size
+    c->contentLength = c->frame.payloadSize > REQUEST_MAX_SIZE ? REQUEST_MAX_SIZE + 1 : c->frame.payloadSize;
+
+    return true;
 }
 
-char* SV_solveRouteAndGetResponse(Server *s, Request request) {
-    for (int i = 0; i < s->routesPtr; i++) {
-        const Route currentRoute = s->routes[i];
+void SV_reserveBuffer(Connection *c, size_t capacity) {
+    if (c->bufferCapacity >= capacity)
+        return;
+
+    while (c->bufferCapacity < capacity)
+        c->bufferCapacity *= 2;
+
+    c->buffer = realloc(c->buffer, sizeof(char) * (c->bufferCapacity + 1));
+
+    if (c->buffer == NULL) {
+        fprintf(stderr, "Server Error: Unable to allocate %lu bytes\n", c->bufferCapacity + 1);
+        exit(1);
+    }
+}
+
+bool SV_readRequest(Server *s, Connection *c);
+void SV_queueConnection(Server *s, Connection *c);
+
+const char* SV_getHttpMethodName(enum http_method method) {
+    if (method == HTTP_GET)
+        return "GET";
+    else if (method == HTTP_POST)
+        return "POST";
+    else
+        return "OTHER";
+}
+
+void SV_logAccess(Server *s, Connection *c) {
+    if (s->logger == NULL)
+        return;
+
+    logger_log(s->logger, "%s \"%s %.*s\" %u %lu\n", c->address,
+        SV_getHttpMethodName(c->request.method), (int) c->request.path.size, c->request.path.data,
+        responseCreator_getStatusCode(c->response), c->responseTotalSent);
+}
+
+void SV_finishRequest(Connection *c) {
+    const size_t requestSize = c->headersSize + c->contentLength;
+
+    //The pipelined requests move to the start of the buffer
+    c->bufferSize -= requestSize;
+    memmove(c->buffer, c->buffer + requestSize, c->bufferSize);
+    c->buffer[c->bufferSize] = 0;
 
-        if (currentRoute.method == request.method && strcmp(currentRoute.path, request.path) == 0) {
-            ResponseCreator* rc = currentRoute.callback(request);
+    c->scannedSize = 0;
+    c->headersSize = 0;
+    c->contentLength = 0;
+    c->errorStatus = 0;
 
-            char* response = responseCreator_getResponse(rc);
-            responseCreator_free(rc);
+    if (c->response != NULL)
+        responseCreator_free(c->response);
 
-            return response;
+    c->response = NULL;
+    c->responseSize = 0;
+    c->responseSent = 0;
+    c->responseTotalSent = 0;
+    c->buildTime = 0;
+    c->writeTime = 0;
+
+    c->state = SV_READING;
+    c->lastActivity = SV_now();
+}
+
+//Reads until the client closes, nothing read is kept (the buffer is only scratch here)
+void SV_discardInput(Server *s, Connection *c) {
+    while (true) {
+        const ssize_t received = read(c->fd, c->buffer, c->bufferCapacity);
+
+        if (received == -1 && errno == EINTR)
+            continue;
+
+        if (received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+
+        if (received <= 0) {
+            SV_closeConnection(s, c);
+            return;
         }
     }
+}
+
+/*
+    The rest of a refused request can still be coming, closing with unread
+    bytes resets the connection and the client can lose the response, so only
+    the writes are closed and the reads are discarded until the client closes
+    (or the idle timeout).
+*/
+void SV_drainConnection(Server *s, Connection *c) {
+    shutdown(c->fd, SHUT_WR);
 
-    ResponseCreator* rc = responseCreator_init(TYPE_JSON, 404);
+    c->state = SV_DRAINING;
+    c->lastActivity = SV_now();
 
-    char* response = responseCreator_getResponse(rc);
-    responseCreator_free(rc);
+    SV_discardInput(s, c);
+}
 
-    return response;
+//The time of the response (all chunks) is observed when it is over
+void SV_observeResponse(Server *s, Connection *c) {
+    metrics_observe(s->metrics, s->buildHistogram, c->buildTime);
+    metrics_observe(s->metrics, s->writeHistogram, c->writeTime);
 }
 
-void SV_handleRequest(Server *s) {
-    Request request = SV_parseRequest(s);
+bool SV_writeResponse(Server *s, Connection *c) {
+    const uint64_t start = metrics_now();
+
+    while (c->responseSent < c->responseSize) {
+        //Header and content go in the same call, skipping what was already sent
+        struct iovec parts[2];
+        size_t partsCount = 0;
+        size_t skip = c->responseSent;
+
+        for (int i = 0; i < 2; i++) {
+            if (skip >= c->responseParts[i].iov_len) {
+                skip -= c->responseParts[i].iov_len;
+                continue;
+            }
+
+            parts[partsCount].iov_base = (char*) c->responseParts[i].iov_base + skip;
+            parts[partsCount].iov_len = c->responseParts[i].iov_len - skip;
+            partsCount++;
+            skip = 0;
+        }
 
-    char* response = SV_solveRouteAndGetResponse(s, request);
+        //sendmsg is writev with MSG_NOSIGNAL
+        struct msghdr message = {
+            .msg_iov = parts,
+            .msg_iovlen = partsCount,
+        };
 
-    write(s->connfd, response, strlen(response)-1);
-    
-    free(response);
-    SV_freeRequest(request);
+        const ssize_t sent = sendmsg(c->fd, &message, MSG_NOSIGNAL);
+
+        if (sent == -1 && errno == EINTR)
+            continue;
+
+        //The rest is written when epoll says the socket is writable again
+        if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            c->writeTime += metrics_now() - start;
+            return true;
+        }
+
+        if (sent == -1) {
+            SV_closeConnection(s, c);
+            return false;
+        }
+
+        c->responseSent += sent;
+        c->responseTotalSent += sent;
+        c->lastActivity = SV_now();
+
+        metrics_add(s->metrics, s->bytesOutCounter, sent);
+    }
+
+    c->writeTime += metrics_now() - start;
+
+    //The chunk was sent, a worker makes the next one
+    if (c->response != NULL && responseCreator_hasNextChunk(c->response)) {
+        SV_queueConnection(s, c);
+        return false;
+    }
+
+    //The frames aren't logged, only the upgrade
+    if (!c->isWebSocket)
+        SV_logAccess(s, c);
+
+    SV_observeResponse(s, c);
+
+    if (!c->keepAlive) {
+        if (c->errorStatus != 0)
+            SV_drainConnection(s, c);
+        else
+            SV_closeConnection(s, c);
+
+        return false;
+    }
+
+    //The upgrade was sent, the next bytes are frames
+    c->isWebSocket = c->webSocket != NULL;
+
+    SV_finishRequest(c);
+
+    //Events that came while processing were lost (edge triggered), so read now
+    return SV_readRequest(s, c);
 }
 
-Server* server_init(uint16_t port) {
+/*
+    The reply of a frame is one frame with the whole response, the control
+    frames are answered here: a pong with the payload of the ping and the
+    close with the status code of the client.
+*/
+void SV_processFrame(Server *s, Connection *c) {
+    char *payload = c->buffer + c->headersSize;
+    enum webSocket_opcode opcode = c->frame.opcode;
+    ResponseCreator *rc = NULL;
+    size_t contentSize = 0;
+
+    webSocket_unmask(payload, c->contentLength, c->frame.mask);
+
+    if (opcode == WEB_SOCKET_TEXT || opcode == WEB_SOCKET_BINARY) {
+        const StringView message = { payload, c->contentLength };
+
+        const uint64_t start = metrics_now();
+        rc = c->webSocket->handlers.message(c->webSocketState, message);
+        metrics_observe(s->metrics, c->webSocket->callbackHistogram, metrics_now() - start);
+
+        if (rc != NULL)
+            opcode = responseCreator_getContentType(rc) == TYPE_BINARY ? WEB_SOCKET_BINARY : WEB_SOCKET_TEXT;
+    }
+    else if (opcode == WEB_SOCKET_PING || opcode == WEB_SOCKET_CLOSE) {
+        rc = responseCreator_init(TYPE_BINARY, 200);
+        responseCreator_appendBytes(rc, payload, c->contentLength);
+
+        if (opcode == WEB_SOCKET_PING)
+            opcode = WEB_SOCKET_PONG;
+        else
+            c->keepAlive = false;
+    }
+
+    c->response = rc;
+    c->responseParts[0].iov_base = c->upgradeHeader;
+    c->responseParts[0].iov_len = 0;
+    c->responseParts[1].iov_base = NULL;
+
+    if (rc != NULL) {
+        c->responseParts[1].iov_base = (void*) responseCreator_getContent(rc, &contentSize);
+        c->responseParts[0].iov_len = webSocket_writeFrameHeader(opcode, contentSize, c->upgradeHeader);
+    }
+
+    c->responseParts[1].iov_len = contentSize;
+    c->responseSize = c->responseParts[0].iov_len + contentSize;
+    c->responseSent = 0;
+}
+
+void SV_processRequest(void *context, void *job) {
+    Server *s = (Server*) context;
+    Connection *c = (Connection*) job;
+
+    size_t headerSize = 0, contentSize;
+    uint64_t start;
+
+    if (c->isWebSocket) {
+        start = metrics_now();
+        SV_processFrame(s, c);
+        c->buildTime = metrics_now() - start;
+    }
+    //A stream comes back here for each chunk, only the first one has the header
+    else if (c->response == NULL) {
+        ResponseCreator *rc = SV_solveRouteAndGetResponse(s, c);
+
+        //HTTP/1.0 has no chunks, the end of the stream is the end of the connection
+        if (c->isHttp10 && responseCreator_isStream(rc)) {
+            c->keepAlive = false;
+            responseCreator_setKeepAlive(rc, false);
+            responseCreator_setChunked(rc, false);
+        }
+
+        c->response = rc;
+
+        start = metrics_now();
+
+        if (c->webSocket != NULL) {
+            headerSize = strlen(c->upgradeHeader);
+            c->responseParts[0].iov_base = c->upgradeHeader;
+        }
+        else {
+            c->responseParts[0].iov_base = (void*) responseCreator_getHeader(rc, &headerSize);
+        }
+    }
+    else {
+        start = metrics_now();
+    }
+
+    if (!c->isWebSocket) {
+        responseCreator_nextChunk(c->response);
+        c->buildTime += metrics_now() - start;
+
+        c->responseParts[0].iov_len = headerSize;
+        c->responseParts[1].iov_base = (void*) responseCreator_getContent(c->response, &contentSize);
+        c->responseParts[1].iov_len = contentSize;
+        c->responseSize = headerSize + contentSize;
+        c->responseSent = 0;
+    }
+
+    //The I/O thread keeps at most as many connections in flight as the done queue holds
+    while (!workQueue_push(s->done, c));
+
+    const uint64_t wake = 1;
+    while (write(s->wakefd, &wake, sizeof(wake)) == -1 && errno == EINTR);
+}
+
+void SV_submitPendingRequests(Server *s) {
+    const size_t doneCapacity = SV_JOBS_QUEUE_SIZE + s->threadsCount;
+
+    //Every connection in flight has a cell in the done queue, so the workers never wait to push
+    while (s->pendingHead != NULL && s->inFlight < doneCapacity && threadPool_submit(s->workers, s->pendingHead)) {
+        s->inFlight++;
+        s->pendingHead = s->pendingHead->nextPending;
+
+        if (s->pendingHead == NULL)
+            s->pendingTail = NULL;
+    }
+}
+
+void SV_queueConnection(Server *s, Connection *c) {
+    c->state = SV_PROCESSING;
+
+    //With the pool (or the done queue) full, the request waits here (in order) until a worker is done
+    c->nextPending = NULL;
+
+    if (s->pendingTail != NULL)
+        s->pendingTail->nextPending = c;
+    else
+        s->pendingHead = c;
+
+    s->pendingTail = c;
+
+    SV_submitPendingRequests(s);
+}
+
+void SV_handleRequest(Server *s, Connection *c) {
+    c->requestsCount++;
+    c->keepAlive = c->keepAlive && c->requestsCount < SV_MAX_REQUESTS_PER_CONNECTION;
+
+    //The buffer doesn't move until the response is written, so the views stay valid
+    c->request.path.data = c->buffer + c->pathOffset;
+    c->request.path.size = c->pathSize;
+    c->request.query.data = c->buffer + c->pathOffset + c->pathSize + 1;
+    c->request.query.size = c->querySize;
+    c->request.headers.data = c->buffer + c->headersOffset;
+    c->request.headers.size = c->headersSize - 2 - c->headersOffset;
+    c->request.content.data = c->buffer + c->headersSize;
+    c->request.content.size = c->contentLength;
+
+    metrics_observe(s->metrics, s->parseHistogram, c->parseTime);
+    c->parseTime = 0;
+
+    SV_queueConnection(s, c);
+}
+
+//Fragmented messages aren't supported and the frames of the client must be masked
+void SV_handleFrame(Server *s, Connection *c) {
+    const enum webSocket_opcode opcode = c->frame.opcode;
+    const bool isKnownOpcode = opcode == WEB_SOCKET_TEXT || opcode == WEB_SOCKET_BINARY ||
+                               opcode == WEB_SOCKET_CLOSE || opcode == WEB_SOCKET_PING || opcode == WEB_SOCKET_PONG;
+
+    if (!c->frame.isFinal || !c->frame.isMasked || !isKnownOpcode) {
+        SV_closeConnection(s, c);
+        return;
+    }
+
+    c->parseTime = 0;
+
+    SV_queueConnection(s, c);
+}
+
+void SV_handleProcessedRequests(Server *s) {
+    uint64_t wakes;
+    void *job;
+
+    while (read(s->wakefd, &wakes, sizeof(wakes)) > 0);
+
+    while (workQueue_pop(s->done, &job)) {
+        Connection *c = (Connection*) job;
+        s->inFlight--;
+
+        c->state = SV_WRITING;
+        SV_writeResponse(s, c);
+    }
+
+    SV_submitPendingRequests(s);
+}
+
+bool SV_readRequest(Server *s, Connection *c) {
+    while (true) {
+        const uint64_t parseStart = metrics_now();
+        const bool isParsed = c->isWebSocket ? SV_parseFrame(c) : SV_parseHeaders(c);
+        c->parseTime += metrics_now() - parseStart;
+
+        //A pipelined request can be already in the buffer
+        if (isParsed) {
+            const size_t requestSize = c->headersSize + c->contentLength;
+
+            if (requestSize > REQUEST_MAX_SIZE)
+                break;
+
+            if (c->bufferSize >= requestSize) {
+                if (c->isWebSocket)
+                    SV_handleFrame(s, c);
+                else
+                    SV_handleRequest(s, c);
+
+                return false;
+            }
+
+            //The whole content fits in the buffer after one resize
+            SV_reserveBuffer(c, requestSize);
+        }
+        else if (c->bufferSize > REQUEST_MAX_SIZE) {
+            break;
+        }
+
+        SV_reserveBuffer(c, c->bufferSize + SV_READ_CHUNK_SIZE);
+
+        const ssize_t received = read(c->fd, c->buffer + c->bufferSize, c->bufferCapacity - c->bufferSize);
+
+        if (received == -1 && errno == EINTR)
+            continue;
+
+        //Everything available was read, wait for the next event
+        if (received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+
+        //Closed by the client or failed before sending a whole request
+        if (received <= 0) {
+            SV_closeConnection(s, c);
+            return false;
+        }
+
+        c->bufferSize += received;
+        c->buffer[c->bufferSize] = 0;
+        c->lastActivity = SV_now();
+
+        metrics_add(s->metrics, s->bytesInCounter, received);
+    }
+
+    fprintf(stderr, "Server Error => server_start: Request bigger than %d bytes\n", REQUEST_MAX_SIZE);
+    SV_closeConnection(s, c);
+
+    return false;
+}
+
+void SV_closeIdleConnections(Server *s) {
+    const time_t now = SV_now();
+
+    if (now - s->lastSweep < SV_SWEEP_INTERVAL / 1000)
+        return;
+
+    s->lastSweep = now;
+
+    Connection *c = s->connections;
+
+    while (c != NULL) {
+        Connection *next = c->next;
+        const time_t timeout = c->isWebSocket ? SV_WEB_SOCKET_IDLE_TIMEOUT : SV_IDLE_TIMEOUT;
+
+        //Waiting a request or a client that doesn't read the response
+        if (c->state != SV_PROCESSING && now - c->lastActivity >= timeout)
+            SV_closeConnection(s, c);
+
+        c = next;
+    }
+}
+
+//Only the numeric address, a reverse DNS lookup would block the accept loop
+void SV_logConnection(Server *s, Connection *c, struct sockaddr_in cli) {
+    char ip[INET_ADDRSTRLEN];
+
+    if (inet_ntop(AF_INET, &cli.sin_addr, ip, sizeof(ip)) == NULL)
+        strcpy(ip, "?");
+
+    snprintf(c->address, SV_ADDRESS_MAX_SIZE, "%s:%u", ip, ntohs(cli.sin_port));
+
+    logger_log(s->logger, "Server established connection with %s\n", c->address);
+}
+
+void SV_acceptConnections(Server *s) {
+    struct sockaddr_in cli;
+    socklen_t cliLen;
+
+    //Edge triggered, so accept until there is no pending connection
+    while (true) {
+        cliLen = sizeof(cli);
+
+        const int connfd = accept(s->sockfd, (SA*)&cli, &cliLen);
+
+        if (connfd == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return;
+
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+
+            fprintf(stderr, "Server Error => server_start: Accept failed\n");
+            exit(1);
+        }
+
+        SV_setNonBlockingOrExitWithError(connfd);
+        Connection *c = SV_openConnection(s, connfd);
+
+        if (s->logger != NULL)
+            SV_logConnection(s, c, cli);
+    }
+}
+
+void SV_handleConnectionEvent(Server *s, Connection *c, uint32_t events) {
+    //A worker is using it, the error (if any) shows up again when writing
+    if (c->fd == -1 || c->state == SV_PROCESSING)
+        return;
+
+    if (events & EPOLLERR) {
+        SV_closeConnection(s, c);
+        return;
+    }
+
+    if (c->state == SV_READING && (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)))
+        SV_readRequest(s, c);
+    else if (c->state == SV_WRITING && (events & EPOLLOUT))
+        SV_writeResponse(s, c);
+    else if (c->state == SV_DRAINING && (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)))
+        SV_discardInput(s, c);
+}
+
+Server* server_init(uint16_t port, size_t threadsCount) {
     Server* s = (Server*) malloc(sizeof(Server));
 
     if (s != NULL) {
         s->sockfd = 0;
-        s->connfd = 0;
+        s->epollfd = 0;
+        s->wakefd = 0;
+        s->connections = NULL;
+        s->closed = NULL;
+        s->pendingHead = NULL;
+        s->pendingTail = NULL;
+        s->workers = NULL;
+        s->isAccessLogEnabled = true;
+        s->logger = NULL;
+        s->threadsCount = threadsCount > 0 ? threadsCount : 1;
+        s->done = NULL;
+        s->inFlight = 0;
+        s->lastSweep = 0;
         
         s->port = port;
 
-        s->routesPtr = 0;
+        s->router = router_init();
+
+        s->metrics = metrics_init();
+        s->routes = NULL;
+        s->routesCount = 0;
+        s->parseHistogram = metrics_addHistogram(s->metrics, "server_parse_seconds", NULL,
+            "Time to parse the request line and headers");
+        s->buildHistogram = metrics_addHistogram(s->metrics, "server_response_build_seconds", NULL,
+            "Time to build the header and the content (all chunks) of the response");
+        s->writeHistogram = metrics_addHistogram(s->metrics, "server_write_seconds", NULL,
+            "Time in the writes of the response");
+        s->bytesInCounter = metrics_addCounter(s->metrics, "server_received_bytes_total", NULL,
+            "Bytes read from the clients");
+        s->bytesOutCounter = metrics_addCounter(s->metrics, "server_sent_bytes_total", NULL,
+            "Bytes written to the clients");
+        s->connectionsGauge = metrics_addGauge(s->metrics, "server_active_connections", NULL,
+            "Connections open now");
     }
 
     return s;
@@ -174,34 +1042,154 @@ void server_free(Server *s) {
     if (s->sockfd != 0)
         close(s->sockfd);
 
-    if (s->connfd != 0)
-        close(s->connfd);
+    if (s->workers != NULL)
+        threadPool_free(s->workers);
+
+    while (s->connections != NULL)
+        SV_closeConnection(s, s->connections);
+
+    SV_freeClosedConnections(s);
+
+    if (s->done != NULL)
+        workQueue_free(s->done);
+
+    if (s->logger != NULL)
+        logger_free(s->logger);
+
+    router_free(s->router);
+    metrics_free(s->metrics);
+    free(s->routes);
+
+    if (s->wakefd != 0)
+        close(s->wakefd);
+
+    if (s->epollfd != 0)
+        close(s->epollfd);
 
     free(s);
 }
 
+StringView server_getHeader(Request r, const char *name) {
+    const char *headersEnd = r.headers.data + r.headers.size;
+    const char *line = r.headers.data;
+    StringView value = { NULL, 0 };
+
+    while (line < headersEnd) {
+        const char *lineEnd = memchr(line, '\r', headersEnd - line);
+
+        if (lineEnd == NULL)
+            lineEnd = headersEnd;
+
+        if (SV_isHeader(line, lineEnd - line, name)) {
+            value.data = line + strlen(name) + 1;
+
+            while (value.data < lineEnd && (*value.data == ' ' || *value.data == '\t'))
+                value.data++;
+
+            value.size = lineEnd - value.data;
+
+            return value;
+        }
+
+        line = lineEnd + 2;
+    }
+
+    return value;
+}
+
+StringView server_getQueryParameter(Request r, const char *name) {
+    const size_t nameLen = strlen(name);
+    const char *queryEnd = r.query.data + r.query.size;
+    const char *parameter = r.query.data;
+    StringView value = { NULL, 0 };
+
+    while (parameter < queryEnd) {
+        const char *parameterEnd = memchr(parameter, '&', queryEnd - parameter);
+
+        if (parameterEnd == NULL)
+            parameterEnd = queryEnd;
+
+        if ((size_t) (parameterEnd - parameter) >= nameLen && memcmp(parameter, name, nameLen) == 0 &&
+            (parameter + nameLen == parameterEnd || parameter[nameLen] == '=')) {
+
+            value.data = parameter + nameLen < parameterEnd ? parameter + nameLen + 1 : parameterEnd;
+            value.size = parameterEnd - value.data;
+
+            return value;
+        }
+
+        parameter = parameterEnd + 1;
+    }
+
+    return value;
+}
+
+void server_setAccessLog(Server *s, bool isEnabled) {
+    s->isAccessLogEnabled = isEnabled;
+}
+
+struct SV_route* SV_addRoute(Server *s, const char *path,
+                             enum http_method method, RouteCallback callback) {
+
+    router_add(s->router, method, path, callback);
+
+    //A new route (not a replaced one), its index is the last one
+    if (router_getSize(s->router) > s->routesCount) {
+        //The path escaped, however long it is
+        char* route = SV_mallocOrExitWithError(strlen(path) * 2 + 1);
+        metrics_escapeLabelValue(route, path);
+
+        const char* methodName = SV_getHttpMethodName(method);
+        const size_t labelsSize = strlen(methodName) + strlen(route) + sizeof("method=\"\",route=\"\"");
+        char* labels = SV_mallocOrExitWithError(labelsSize);
+        snprintf(labels, labelsSize, "method=\"%s\",route=\"%s\"", methodName, route);
+
+        s->routesCount++;
+        s->routes = realloc(s->routes, sizeof(struct SV_route) * s->routesCount);
+
+        if (s->routes == NULL) {
+            fprintf(stderr, "Server Error => server_addRoute: Unable to allocate the route metrics\n");
+            exit(1);
+        }
+
+        s->routes[s->routesCount - 1].callbackHistogram = metrics_addHistogram(s->metrics,
+            "server_callback_seconds", labels, "Time in the route callback");
+
+        free(labels);
+        free(route);
+    }
+
+    size_t index;
+    const StringView pathView = { path, strlen(path) };
+    router_find(s->router, method, pathView, &index);
+
+    return &s->routes[index];
+}
+
 void server_addRoute(Server *s, const char *path, 
                      enum http_method method, RouteCallback callback) {
     
-    if (s->routesPtr == ROUTES_MAX_SIZE) {
-        fprintf(stderr, "Server Error => server_addRoute: There is no more space to add routes\n");
-        exit(1);
-    }
+    SV_addRoute(s, path, method, callback)->isWebSocket = false;
+}
 
-    Route route = {
-        .path = path,
-        .method = method,
-        .callback = callback,
-    };
+//The callback of a WebSocket route, only called for the requests that aren't an upgrade
+ResponseCreator* SV_refuseWebSocketRequest(Request req) {
+    return responseCreator_init(TYPE_JSON, 400);
+}
+
+void server_addWebSocketRoute(Server *s, const char *path, WebSocketHandlers handlers) {
+    struct SV_route *route = SV_addRoute(s, path, HTTP_GET, SV_refuseWebSocketRequest);
 
-    s->routes[s->routesPtr] = route;
-    s->routesPtr++;
+    route->isWebSocket = true;
+    route->handlers = handlers;
+}
+
+Metrics* server_getMetrics(Server *s) {
+    return s->metrics;
 }
 
 void server_start(Server *s) {
-    int cliLen;
-    struct sockaddr_in servaddr, cli;
-    struct hostent *hostp;
+    struct sockaddr_in servaddr;
 
     s->sockfd = socket(AF_INET, SOCK_STREAM, 0);
     if (s->sockfd == -1) {
@@ -224,46 +1212,75 @@ void server_start(Server *s) {
         exit(1);
     }
 
-    if (listen(s->sockfd, 5) != 0) {
+    if (listen(s->sockfd, SV_LISTEN_BACKLOG) != 0) {
         fprintf(stderr, "Server Error => server_start: Listen failed\n");
         exit(1);
     }
 
-    printf("Server listening on port: %d\n", s->port);
+    SV_setNonBlockingOrExitWithError(s->sockfd);
+
+    s->epollfd = epoll_create1(0);
+    if (s->epollfd == -1) {
+        fprintf(stderr, "Server Error => server_start: Epoll creation failed\n");
+        exit(1);
+    }
+
+    s->wakefd = eventfd(0, EFD_NONBLOCK);
+    if (s->wakefd == -1) {
+        fprintf(stderr, "Server Error => server_start: Eventfd creation failed\n");
+        exit(1);
+    }
+
+    //The listening socket and the eventfd are the only ones without a Connection
+    struct epoll_event listenEvent = {
+        .events = EPOLLIN | EPOLLET,
+        .data.ptr = &s->sockfd,
+    };
 
-    cliLen = sizeof(cli);
+    struct epoll_event wakeEvent = {
+        .events = EPOLLIN | EPOLLET,
+        .data.ptr = &s->wakefd,
+    };
 
-    while (true) {
-        char *hostaddrp;
+    if (epoll_ctl(s->epollfd, EPOLL_CTL_ADD, s->sockfd, &listenEvent) == -1 ||
+        epoll_ctl(s->epollfd, EPOLL_CTL_ADD, s->wakefd, &wakeEvent) == -1) {
+        fprintf(stderr, "Server Error => server_start: Unable to watch the socket\n");
+        exit(1);
+    }
 
-        s->connfd = accept(s->sockfd, (SA*)&cli, &cliLen);
+    //Each connection is at most once in the pool, so the done queue never gets full
+    s->workers = threadPool_init(s->threadsCount, SV_JOBS_QUEUE_SIZE, SV_processRequest, s);
+    s->done = workQueue_init(SV_JOBS_QUEUE_SIZE + s->threadsCount);
 
-        if (s->connfd < 0) {
-            fprintf(stderr, "Server Error => server_start: Accept failed\n");
-            exit(1);
-        }
+    if (s->isAccessLogEnabled)
+        s->logger = logger_init(SV_LOG_CAPACITY, stdout);
 
-        hostp = gethostbyaddr((const char*) &cli.sin_addr.s_addr,
-            sizeof(cli.sin_addr.s_addr), AF_INET);
+    printf("Server listening on port: %d (%lu workers)\n", s->port, s->threadsCount);
 
-        if (hostp == NULL) {
-            fprintf(stderr, "Server Error => server_start: Error on gethostbyaddr\n");
-            exit(1);
-        }
+    struct epoll_event events[SV_MAX_EVENTS];
+
+    while (true) {
+        const int eventsCount = epoll_wait(s->epollfd, events, SV_MAX_EVENTS, SV_SWEEP_INTERVAL);
 
-        hostaddrp = inet_ntoa(cli.sin_addr);
+        if (eventsCount == -1) {
+            if (errno == EINTR)
+                continue;
 
-        if (hostaddrp == NULL) {
-            fprintf(stderr, "Server Error => server_start: Error on inet_ntoa\n");
+            fprintf(stderr, "Server Error => server_start: Epoll wait failed\n");
             exit(1);
         }
 
-        printf("Server established connection with %s (%s)\n", 
-	        hostp->h_name, hostaddrp);
-
-        SV_handleRequest(s);
+        for (int i = 0; i < eventsCount; i++) {
+            if (events[i].data.ptr == &s->sockfd)
+                SV_acceptConnections(s);
+            else if (events[i].data.ptr == &s->wakefd)
+                SV_handleProcessedRequests(s);
+            else
+                SV_handleConnectionEvent(s, events[i].data.ptr, events[i].events);
+        }
 
-        close(s->connfd);
+        SV_closeIdleConnections(s);
+        SV_freeClosedConnections(s);
     }
 
     close(s->sockfd);
@@ -2,7 +2,10 @@
 #define SERVER_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 #include "responseCreator/responseCreator.h"
+#include "metrics/metrics.h"
 
 enum http_method {
     HTTP_GET,
@@ -10,22 +13,56 @@ enum http_method {
     HTTP_OTHER,
 };
 
+typedef struct {
+    const char *data;
+    size_t size;
+} StringView;
+
+//The views point into the connection buffer (not NUL terminated), only valid in the callback
 typedef struct {
     enum http_method method;
-    char *path;
-    char *content;
+    StringView path;
+    StringView query;
+    StringView headers;
+    StringView content;
 } Request;
 
 typedef ResponseCreator* (*RouteCallback)(Request req);
 
+/*
+    A WebSocket route keeps one state per connection: open is called with the
+    upgrade request, message with each text or binary message and close when
+    the connection is over. The calls of one connection never overlap.
+    The reply of a message (not a stream) goes in a binary frame when its
+    content type is TYPE_BINARY, else in a text one, and nothing is sent for NULL.
+*/
+typedef struct {
+    void* (*open)(Request req);
+    ResponseCreator* (*message)(void *state, StringView message);
+    void (*close)(void *state);
+} WebSocketHandlers;
+
 typedef struct server Server;
 
-Server* server_init(uint16_t port);
+Server* server_init(uint16_t port, size_t threadsCount);
 void server_free(Server *s);
 
 void server_addRoute(Server *s, const char *path, 
                      enum http_method method, RouteCallback callback);
 
+//GET requests without the upgrade headers are answered with 400
+void server_addWebSocketRoute(Server *s, const char *path, WebSocketHandlers handlers);
+
+//Enabled by default, one line per connection and per response written by a background thread
+void server_setAccessLog(Server *s, bool isEnabled);
+
 void server_start(Server *s);
 
+//Latencies of each step, bytes and connections, the routes can add their own metrics before the start
+Metrics* server_getMetrics(Server *s);
+
+//Both return an empty view (data NULL) when there is no such header or parameter
+StringView server_getHeader(Request r, const char *name);
+StringView server_getQueryParameter(Request r, const char *name);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,286 @@
+#include "sourceBatch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define SB_INITIAL_SOURCES_CAPACITY 16
+
+struct source {
+    size_t offset;
+    size_t size;
+};
+
+/*
+    A decoded source (and its NUL) is never bigger than its framing (the quotes
+    or the length), so all of them fit in one buffer of the content size.
+*/
+struct sourceBatch {
+    char* data;
+    size_t dataSize;
+    struct source* sources;
+    size_t sourcesCount;
+    size_t sourcesCapacity;
+};
+
+void* SB_mallocOrExitWithError(size_t size) {
+    void* m = malloc(size);
+
+    if (m == NULL) {
+        fprintf(stderr, "Source Batch Error: Unable to allocate %lu bytes\n", size);
+        exit(1);
+    }
+
+    return m;
+}
+
+SourceBatch* SB_init(size_t contentSize) {
+    SourceBatch* sb = SB_mallocOrExitWithError(sizeof(SourceBatch));
+
+    sb->data = SB_mallocOrExitWithError(sizeof(char) * (contentSize + 1));
+    sb->dataSize = 0;
+
+    sb->sourcesCapacity = SB_INITIAL_SOURCES_CAPACITY;
+    sb->sourcesCount = 0;
+    sb->sources = SB_mallocOrExitWithError(sizeof(struct source) * sb->sourcesCapacity);
+
+    return sb;
+}
+
+//The source is the data from the offset to the end, then the NUL is added
+void SB_addSource(SourceBatch* sb, size_t offset) {
+    if (sb->sourcesCount == sb->sourcesCapacity) {
+        sb->sourcesCapacity *= 2;
+        sb->sources = realloc(sb->sources, sizeof(struct source) * sb->sourcesCapacity);
+
+        if (sb->sources == NULL) {
+            fprintf(stderr, "Source Batch Error: Unable to allocate %lu sources\n", sb->sourcesCapacity);
+            exit(1);
+        }
+    }
+
+    sb->sources[sb->sourcesCount].offset = offset;
+    sb->sources[sb->sourcesCount].size = sb->dataSize - offset;
+    sb->sourcesCount++;
+
+    sb->data[sb->dataSize++] = 0;
+}
+
+#pragma region JSON
+
+const char* SB_skipSpaces(const char* from, const char* to) {
+    while (from < to && (*from == ' ' || *from == '\t' || *from == '\n' || *from == '\r'))
+        from++;
+
+    return from;
+}
+
+int SB_readHexDigit(char ch) {
+    if (ch >= '0' && ch <= '9')
+        return ch - '0';
+    else if (ch >= 'a' && ch <= 'f')
+        return ch - 'a' + 10;
+    else if (ch >= 'A' && ch <= 'F')
+        return ch - 'A' + 10;
+    else
+        return -1;
+}
+
+//The 4 digits after "\u", -1 when they aren't hex
+long SB_readCodeUnit(const char* from, const char* to) {
+    if (to - from < 4)
+        return -1;
+
+    long unit = 0;
+
+    for (int i = 0; i < 4; i++) {
+        const int digit = SB_readHexDigit(from[i]);
+
+        if (digit == -1)
+            return -1;
+
+        unit = unit * 16 + digit;
+    }
+
+    return unit;
+}
+
+void SB_writeUtf8(SourceBatch* sb, long codePoint) {
+    char* out = sb->data + sb->dataSize;
+
+    if (codePoint < 0x80) {
+        out[0] = codePoint;
+        sb->dataSize += 1;
+    }
+    else if (codePoint < 0x800) {
+        out[0] = 0xC0 | (codePoint >> 6);
+        out[1] = 0x80 | (codePoint & 0x3F);
+        sb->dataSize += 2;
+    }
+    else if (codePoint < 0x10000) {
+        out[0] = 0xE0 | (codePoint >> 12);
+        out[1] = 0x80 | ((codePoint >> 6) & 0x3F);
+        out[2] = 0x80 | (codePoint & 0x3F);
+        sb->dataSize += 3;
+    }
+    else {
+        out[0] = 0xF0 | (codePoint >> 18);
+        out[1] = 0x80 | ((codePoint >> 12) & 0x3F);
+        out[2] = 0x80 | ((codePoint >> 6) & 0x3F);
+        out[3] = 0x80 | (codePoint & 0x3F);
+        sb->dataSize += 4;
+    }
+}
+
+//Decodes the string that starts after the quote, returns the position after the closing quote or NULL
+const char* SB_readString(SourceBatch* sb, const char* from, const char* to) {
+    while (from < to) {
+        //The bytes up to the next quote or escape are copied at once
+        const char* special = from;
+        while (special < to && *special != '"' && *special != '\\')
+            special++;
+
+        memcpy(sb->data + sb->dataSize, from, special - from);
+        sb->dataSize += special - from;
+        from = special;
+
+        if (from == to)
+            return NULL;
+
+        if (*from == '"')
+            return from + 1;
+
+        if (to - from < 2)
+            return NULL;
+
+        const char escaped = from[1];
+        from += 2;
+
+        switch (escaped) {
+            case '"': sb->data[sb->dataSize++] = '"'; break;
+            case '\\': sb->data[sb->dataSize++] = '\\'; break;
+            case '/': sb->data[sb->dataSize++] = '/'; break;
+            case 'b': sb->data[sb->dataSize++] = '\b'; break;
+            case 'f': sb->data[sb->dataSize++] = '\f'; break;
+            case 'n': sb->data[sb->dataSize++] = '\n'; break;
+            case 'r': sb->data[sb->dataSize++] = '\r'; break;
+            case 't': sb->data[sb->dataSize++] = '\t'; break;
+            case 'u': {
+                long codePoint = SB_readCodeUnit(from, to);
+
+                if (codePoint == -1)
+                    return NULL;
+
+                from += 4;
+
+                //Out of the BMP it is a surrogate pair, two escapes in a row
+                if (codePoint >= 0xD800 && codePoint <= 0xDBFF) {
+                    if (to - from < 2 || from[0] != '\\' || from[1] != 'u')
+                        return NULL;
+
+                    const long low = SB_readCodeUnit(from + 2, to);
+
+                    if (low < 0xDC00 || low > 0xDFFF)
+                        return NULL;
+
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    from += 6;
+                }
+
+                SB_writeUtf8(sb, codePoint);
+                break;
+            }
+            default:
+                return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+#pragma endregion
+
+SourceBatch* sourceBatch_fromJson(const char* content, size_t size) {
+    const char* end = content + size;
+    const char* p = SB_skipSpaces(content, end);
+
+    if (p == end || *p != '[')
+        return NULL;
+
+    SourceBatch* sb = SB_init(size);
+    p = SB_skipSpaces(p + 1, end);
+
+    //An empty array
+    if (p < end && *p == ']' && SB_skipSpaces(p + 1, end) == end)
+        return sb;
+
+    while (p < end && *p == '"') {
+        const size_t offset = sb->dataSize;
+
+        if ((p = SB_readString(sb, p + 1, end)) == NULL)
+            break;
+
+        SB_addSource(sb, offset);
+        p = SB_skipSpaces(p, end);
+
+        if (p < end && *p == ']' && SB_skipSpaces(p + 1, end) == end)
+            return sb;
+
+        if (p == end || *p != ',')
+            break;
+
+        p = SB_skipSpaces(p + 1, end);
+    }
+
+    sourceBatch_free(sb);
+
+    return NULL;
+}
+
+SourceBatch* sourceBatch_fromBinary(const char* content, size_t size) {
+    const unsigned char* p = (const unsigned char*) content;
+    const unsigned char* end = p + size;
+    SourceBatch* sb = SB_init(size);
+
+    while (p < end) {
+        if (end - p < SOURCE_BATCH_LENGTH_SIZE) {
+            sourceBatch_free(sb);
+            return NULL;
+        }
+
+        const size_t length = (size_t) p[0] | ((size_t) p[1] << 8) | ((size_t) p[2] << 16) | ((size_t) p[3] << 24);
+        p += SOURCE_BATCH_LENGTH_SIZE;
+
+        if ((size_t) (end - p) < length) {
+            sourceBatch_free(sb);
+            return NULL;
+        }
+
+        const size_t offset = sb->dataSize;
+
+        memcpy(sb->data + sb->dataSize, p, length);
+        sb->dataSize += length;
+        p += length;
+
+        SB_addSource(sb, offset);
+    }
+
+    return sb;
+}
+
+void sourceBatch_free(SourceBatch* sb) {
+    free(sb->data);
+    free(sb->sources);
+    free(sb);
+}
+
+size_t sourceBatch_getSize(SourceBatch* sb) {
+    return sb->sourcesCount;
+}
+
+const char* sourceBatch_getSource(SourceBatch* sb, size_t index, size_t* size) {
+    *size = sb->sources[index].size;
+
+    return sb->data + sb->sources[index].offset;
+}
\ No newline at end of file
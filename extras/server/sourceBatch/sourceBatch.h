@@ -0,0 +1,25 @@
+#ifndef SOURCE_BATCH_H
+#define SOURCE_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SOURCE_BATCH_LENGTH_SIZE 4
+
+/*
+    List of sources sent in one request, framed as a JSON array of strings
+    (["int a;", "a = 1;"]) or in binary, as many (u32 little endian length,
+    bytes) as fit in the content. Each source is copied (unescaped) and NUL
+    terminated, so the batch doesn't depend on the request.
+*/
+typedef struct sourceBatch SourceBatch;
+
+//Both return NULL when the content isn't well framed
+SourceBatch* sourceBatch_fromJson(const char* content, size_t size);
+SourceBatch* sourceBatch_fromBinary(const char* content, size_t size);
+void sourceBatch_free(SourceBatch* sb);
+
+size_t sourceBatch_getSize(SourceBatch* sb);
+const char* sourceBatch_getSource(SourceBatch* sb, size_t index, size_t* size);
+
+#endif
\ No newline at end of file
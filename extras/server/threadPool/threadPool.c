@@ -0,0 +1,123 @@
+#include "threadPool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+
+#include "../workQueue/workQueue.h"
+
+/*
+    The semaphore counts the jobs in the queue (and the stop requests), so idle
+    workers sleep on it and every wake up has a job to pop or is told to stop.
+*/
+struct threadPool {
+    pthread_t* threads;
+    size_t threadsCount;
+    WorkQueue* jobs;
+    sem_t available;
+    atomic_bool stopping;
+    ThreadPoolHandler handler;
+    void* context;
+};
+
+void* TP_mallocOrExitWithError(size_t size) {
+    void* m = malloc(size);
+
+    if (m == NULL) {
+        fprintf(stderr, "Thread Pool Error: Unable to allocate %lu bytes\n", size);
+        exit(1);
+    }
+
+    return m;
+}
+
+void* TP_runWorker(void* arg) {
+    ThreadPool* tp = (ThreadPool*) arg;
+    void* job;
+
+    while (true) {
+        while (sem_wait(&tp->available) != 0);
+
+        /*
+            A job is posted only once pushed, but the pop can still fail while
+            the job before it (from another producer) isn't published, so the
+            pop is retried: giving up would leave the job without a worker.
+            Only a stop request wakes up without a job.
+        */
+        while (!workQueue_pop(tp->jobs, &job)) {
+            if (atomic_load(&tp->stopping))
+                return NULL;
+
+            sched_yield();
+        }
+
+        tp->handler(tp->context, job);
+    }
+}
+
+ThreadPool* threadPool_init(size_t threadsCount, size_t queueCapacity,
+                            ThreadPoolHandler handler, void* context) {
+
+    ThreadPool* tp = (ThreadPool*) malloc(sizeof(ThreadPool));
+
+    if (tp != NULL) {
+        tp->threadsCount = threadsCount > 0 ? threadsCount : 1;
+        tp->threads = TP_mallocOrExitWithError(sizeof(pthread_t) * tp->threadsCount);
+        tp->jobs = workQueue_init(queueCapacity);
+        tp->handler = handler;
+        tp->context = context;
+
+        atomic_init(&tp->stopping, false);
+        sem_init(&tp->available, 0, 0);
+
+        //Signals are left to the thread that created the pool
+        sigset_t allSignals, previousSignals;
+        sigfillset(&allSignals);
+        pthread_sigmask(SIG_SETMASK, &allSignals, &previousSignals);
+
+        for (size_t i = 0; i < tp->threadsCount; i++) {
+            if (pthread_create(&tp->threads[i], NULL, TP_runWorker, tp) != 0) {
+                fprintf(stderr, "Thread Pool Error: Unable to create a thread\n");
+                exit(1);
+            }
+        }
+
+        pthread_sigmask(SIG_SETMASK, &previousSignals, NULL);
+    }
+
+    return tp;
+}
+
+void threadPool_free(ThreadPool* tp) {
+    atomic_store(&tp->stopping, true);
+
+    for (size_t i = 0; i < tp->threadsCount; i++)
+        sem_post(&tp->available);
+
+    for (size_t i = 0; i < tp->threadsCount; i++)
+        pthread_join(tp->threads[i], NULL);
+
+    sem_destroy(&tp->available);
+    workQueue_free(tp->jobs);
+    free(tp->threads);
+    free(tp);
+}
+
+bool threadPool_submit(ThreadPool* tp, void* job) {
+    if (!workQueue_push(tp->jobs, job))
+        return false;
+
+    sem_post(&tp->available);
+
+    return true;
+}
+
+size_t threadPool_getThreadsCount(ThreadPool* tp) {
+    return tp->threadsCount;
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+    Fixed number of worker threads that run the handler for each submitted job,
+    the jobs wait in a bounded WorkQueue.
+*/
+typedef struct threadPool ThreadPool;
+
+typedef void (*ThreadPoolHandler)(void* context, void* job);
+
+ThreadPool* threadPool_init(size_t threadsCount, size_t queueCapacity,
+                            ThreadPoolHandler handler, void* context);
+//Runs the jobs already submitted and then stops the threads
+void threadPool_free(ThreadPool* tp);
+
+//Returns false when the queue is full, the job is not taken in that case
+bool threadPool_submit(ThreadPool* tp, void* job);
+size_t threadPool_getThreadsCount(ThreadPool* tp);
+
+#endif
\ No newline at end of file
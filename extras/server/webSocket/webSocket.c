@@ -0,0 +1,193 @@
+#include "webSocket.h"
+
+#include <string.h>
+
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_SHA1_SIZE 20
+#define WS_SHA1_BLOCK_SIZE 64
+
+#pragma region HANDSHAKE
+
+static inline uint32_t WS_rotl(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+void WS_sha1Block(uint32_t* state, const unsigned char* block) {
+    uint32_t w[80];
+
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t) block[i * 4] << 24 | (uint32_t) block[i * 4 + 1] << 16 |
+               (uint32_t) block[i * 4 + 2] << 8 | (uint32_t) block[i * 4 + 3];
+
+    for (int i = 16; i < 80; i++)
+        w[i] = WS_rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        const uint32_t temp = WS_rotl(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = WS_rotl(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+//Only for the handshake, the message is short (the key and the GUID)
+void WS_sha1(const unsigned char* message, size_t size, unsigned char* digest) {
+    uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    unsigned char block[WS_SHA1_BLOCK_SIZE];
+    size_t offset = 0;
+
+    for (; size - offset >= WS_SHA1_BLOCK_SIZE; offset += WS_SHA1_BLOCK_SIZE)
+        WS_sha1Block(state, message + offset);
+
+    //The rest, the 0x80, zeros and the size in bits, in one or two blocks
+    const size_t rest = size - offset;
+    memset(block, 0, sizeof(block));
+    memcpy(block, message + offset, rest);
+    block[rest] = 0x80;
+
+    if (rest >= WS_SHA1_BLOCK_SIZE - 8) {
+        WS_sha1Block(state, block);
+        memset(block, 0, sizeof(block));
+    }
+
+    const uint64_t bits = (uint64_t) size * 8;
+    for (int i = 0; i < 8; i++)
+        block[WS_SHA1_BLOCK_SIZE - 1 - i] = bits >> (i * 8);
+
+    WS_sha1Block(state, block);
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = state[i] >> 24;
+        digest[i * 4 + 1] = state[i] >> 16;
+        digest[i * 4 + 2] = state[i] >> 8;
+        digest[i * 4 + 3] = state[i];
+    }
+}
+
+void WS_base64(const unsigned char* data, size_t size, char* out) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t written = 0;
+
+    for (size_t i = 0; i < size; i += 3) {
+        const uint32_t group = (uint32_t) data[i] << 16 |
+                               (i + 1 < size ? (uint32_t) data[i + 1] << 8 : 0) |
+                               (i + 2 < size ? (uint32_t) data[i + 2] : 0);
+
+        out[written++] = alphabet[(group >> 18) & 0x3F];
+        out[written++] = alphabet[(group >> 12) & 0x3F];
+        out[written++] = i + 1 < size ? alphabet[(group >> 6) & 0x3F] : '=';
+        out[written++] = i + 2 < size ? alphabet[group & 0x3F] : '=';
+    }
+
+    out[written] = 0;
+}
+
+#pragma endregion
+
+void webSocket_getAcceptKey(const char* key, size_t keySize, char* out) {
+    //The keys are 24 chars (base64 of 16 bytes), longer ones are cut
+    unsigned char message[64 + sizeof(WS_GUID)];
+    unsigned char digest[WS_SHA1_SIZE];
+
+    if (keySize > 64)
+        keySize = 64;
+
+    memcpy(message, key, keySize);
+    memcpy(message + keySize, WS_GUID, sizeof(WS_GUID) - 1);
+
+    WS_sha1(message, keySize + sizeof(WS_GUID) - 1, digest);
+    WS_base64(digest, WS_SHA1_SIZE, out);
+}
+
+bool webSocket_parseFrameHeader(const char* data, size_t size, WebSocketFrame* frame) {
+    const unsigned char* bytes = (const unsigned char*) data;
+
+    if (size < 2)
+        return false;
+
+    frame->isFinal = (bytes[0] & 0x80) != 0;
+    frame->opcode = bytes[0] & 0x0F;
+    frame->isMasked = (bytes[1] & 0x80) != 0;
+
+    //7 bits, or 126 and 16 bits, or 127 and 64 bits
+    const unsigned char length = bytes[1] & 0x7F;
+    const size_t lengthSize = length == 127 ? 8 : length == 126 ? 2 : 0;
+
+    frame->headerSize = 2 + lengthSize + (frame->isMasked ? 4 : 0);
+
+    if (size < frame->headerSize)
+        return false;
+
+    if (lengthSize == 0) {
+        frame->payloadSize = length;
+    }
+    else {
+        frame->payloadSize = 0;
+
+        for (size_t i = 0; i < lengthSize; i++)
+            frame->payloadSize = (frame->payloadSize << 8) | bytes[2 + i];
+    }
+
+    if (frame->isMasked)
+        memcpy(frame->mask, bytes + 2 + lengthSize, 4);
+
+    return true;
+}
+
+size_t webSocket_writeFrameHeader(enum webSocket_opcode opcode, uint64_t payloadSize, char* out) {
+    unsigned char* bytes = (unsigned char*) out;
+
+    bytes[0] = 0x80 | opcode;
+
+    if (payloadSize < 126) {
+        bytes[1] = payloadSize;
+        return 2;
+    }
+
+    if (payloadSize <= 0xFFFF) {
+        bytes[1] = 126;
+        bytes[2] = payloadSize >> 8;
+        bytes[3] = payloadSize;
+        return 4;
+    }
+
+    bytes[1] = 127;
+    for (int i = 0; i < 8; i++)
+        bytes[9 - i] = payloadSize >> (i * 8);
+
+    return 10;
+}
+
+void webSocket_unmask(char* payload, size_t size, const unsigned char* mask) {
+    for (size_t i = 0; i < size; i++)
+        payload[i] ^= mask[i & 3];
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef WEB_SOCKET_H
+#define WEB_SOCKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+//Base64 of the 20 bytes of a SHA-1
+#define WEB_SOCKET_ACCEPT_KEY_SIZE 28
+#define WEB_SOCKET_FRAME_HEADER_MAX_SIZE 14
+
+/*
+    The parts of RFC 6455 the server needs: the accept key of the handshake and
+    the frame headers. The payload of a client frame is masked (xor with a key
+    of 4 bytes), the server frames aren't.
+*/
+enum webSocket_opcode {
+    WEB_SOCKET_CONTINUATION = 0x0,
+    WEB_SOCKET_TEXT = 0x1,
+    WEB_SOCKET_BINARY = 0x2,
+    WEB_SOCKET_CLOSE = 0x8,
+    WEB_SOCKET_PING = 0x9,
+    WEB_SOCKET_PONG = 0xA,
+};
+
+typedef struct {
+    bool isFinal;
+    enum webSocket_opcode opcode;
+    bool isMasked;
+    unsigned char mask[4];
+    size_t headerSize;
+    uint64_t payloadSize;
+} WebSocketFrame;
+
+//The Sec-WebSocket-Accept of the Sec-WebSocket-Key, out has room for the NUL
+void webSocket_getAcceptKey(const char* key, size_t keySize, char* out);
+
+//Returns false while the header isn't complete
+bool webSocket_parseFrameHeader(const char* data, size_t size, WebSocketFrame* frame);
+//A final (not fragmented) frame, returns the size written (up to WEB_SOCKET_FRAME_HEADER_MAX_SIZE)
+size_t webSocket_writeFrameHeader(enum webSocket_opcode opcode, uint64_t payloadSize, char* out);
+void webSocket_unmask(char* payload, size_t size, const unsigned char* mask);
+
+#endif
\ No newline at end of file
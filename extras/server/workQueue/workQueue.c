@@ -0,0 +1,128 @@
+#include "workQueue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define WQ_CACHE_LINE_SIZE 64
+
+/*
+    Dmitry Vyukov's bounded MPMC queue:
+        - https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+    Each cell has a sequence number that says if it is ready to be written (equal
+    to the position) or read (equal to the position + 1) in the current lap, so a
+    push or a pop is only a compare and swap of the position.
+*/
+struct cell {
+    atomic_size_t sequence;
+    void* item;
+};
+
+struct workQueue {
+    struct cell* cells;
+    size_t mask;
+    //Producers and consumers touch different positions, keep them in different cache lines
+    _Alignas(WQ_CACHE_LINE_SIZE) atomic_size_t pushPosition;
+    _Alignas(WQ_CACHE_LINE_SIZE) atomic_size_t popPosition;
+};
+
+void* WQ_mallocOrExitWithError(size_t size) {
+    void* m = malloc(size);
+
+    if (m == NULL) {
+        fprintf(stderr, "Work Queue Error: Unable to allocate %lu bytes\n", size);
+        exit(1);
+    }
+
+    return m;
+}
+
+size_t WQ_roundUpToPowerOfTwo(size_t value) {
+    size_t power = 2;
+
+    while (power < value)
+        power *= 2;
+
+    return power;
+}
+
+WorkQueue* workQueue_init(size_t capacity) {
+    WorkQueue* wq = (WorkQueue*) aligned_alloc(WQ_CACHE_LINE_SIZE, sizeof(WorkQueue));
+
+    if (wq != NULL) {
+        capacity = WQ_roundUpToPowerOfTwo(capacity);
+
+        wq->cells = WQ_mallocOrExitWithError(sizeof(struct cell) * capacity);
+        wq->mask = capacity - 1;
+
+        for (size_t i = 0; i < capacity; i++)
+            atomic_init(&wq->cells[i].sequence, i);
+
+        atomic_init(&wq->pushPosition, 0);
+        atomic_init(&wq->popPosition, 0);
+    }
+
+    return wq;
+}
+
+void workQueue_free(WorkQueue* wq) {
+    free(wq->cells);
+    free(wq);
+}
+
+bool workQueue_push(WorkQueue* wq, void* item) {
+    size_t position = atomic_load_explicit(&wq->pushPosition, memory_order_relaxed);
+    struct cell* cell;
+
+    while (true) {
+        cell = &wq->cells[position & wq->mask];
+
+        const size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        const intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&wq->pushPosition, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+            return false;
+        else
+            position = atomic_load_explicit(&wq->pushPosition, memory_order_relaxed);
+    }
+
+    cell->item = item;
+    atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+
+    return true;
+}
+
+bool workQueue_pop(WorkQueue* wq, void** item) {
+    size_t position = atomic_load_explicit(&wq->popPosition, memory_order_relaxed);
+    struct cell* cell;
+
+    while (true) {
+        cell = &wq->cells[position & wq->mask];
+
+        const size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        const intptr_t difference = (intptr_t) sequence - (intptr_t) (position + 1);
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&wq->popPosition, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+            return false;
+        else
+            position = atomic_load_explicit(&wq->popPosition, memory_order_relaxed);
+    }
+
+    *item = cell->item;
+    atomic_store_explicit(&cell->sequence, position + wq->mask + 1, memory_order_release);
+
+    return true;
+}
\ No newline at end of file
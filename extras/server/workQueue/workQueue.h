@@ -0,0 +1,20 @@
+#ifndef WORK_QUEUE_H
+#define WORK_QUEUE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+    Bounded lock-free queue of pointers, any number of threads can push and pop
+    at the same time. The capacity is rounded up to a power of two.
+*/
+typedef struct workQueue WorkQueue;
+
+WorkQueue* workQueue_init(size_t capacity);
+void workQueue_free(WorkQueue* wq);
+
+//Both return false (and do nothing) when the queue is full or empty
+bool workQueue_push(WorkQueue* wq, void* item);
+bool workQueue_pop(WorkQueue* wq, void** item);
+
+#endif
\ No newline at end of file
@@ -5,17 +5,61 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include <string.h>
-
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "charScanner/charScanner.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define BR_INITIAL_LINES_CAPACITY 1024
+#define BR_LINES_INDEX_STEP 65536
+#define BR_LINES_WALK_LIMIT 8
+
+/*
+    The reader works over a cursor that walks a contiguous region of memory:
+        - Double buffer mode: the region is one half of the buffer, when the cursor
+          reaches the limit the next chunk is loaded from the file (and the cursor
+          wraps around when it was the second half).
+        - Mapped mode: the region is the whole mapped file, there is no limit and
+          moving is just a pointer bump.
+        - Memory mode: the same as the mapped mode, but over memory of the caller.
+    In both cases reading at or after the end returns 0, that is the EOF mark.
+
+    Only the byte offset is tracked while moving, the line and column are computed
+    when a location is asked, from a table with the offset where each line starts.
+    The table is built scanning for new lines, when each chunk is loaded in the double buffer
+    mode and lazily (up to the asked offset) in the mapped mode.
+
+    The bulk moves (moveUntilChar, moveWhileSpace...) hand the contiguous part of
+    the region to the charScanner kernels and only cross the limit between calls.
+*/
 struct bufferReader {
     FILE* sourceFile;
     size_t bufferSize;
     char* buffer;
-    bool isNewLine;
-    bool loadFirstPart;
-    size_t startPtr;
-    size_t endPtr;
-    FilePosition startPosition;
-    FilePosition endPosition;
+    char* mappedData;
+    size_t mappedSize;
+    const char* current;
+    const char* limit;
+    const char* end;
+    const char* regionStart;
+    size_t regionOffset;
+    const char* selectionStart;
+    size_t selectionStartOffset;
+    char* scratch;
+    size_t scratchSize;
+    size_t* lineStarts;
+    size_t linesSize;
+    size_t linesCapacity;
+    size_t indexedUntil;
+    size_t lastLine;
+    size_t lineStart;
+    size_t nextLineStart;
 };
 
 FILE* BR_openFileAsReadOrExitWithError(const char* sourceFilePath) {
@@ -40,56 +84,234 @@ void* BR_mallocOrExitWithError(size_t size) {
     return m;
 }
 
-void BR_loadChunk(BufferReader* br) {
-    size_t startPositionToLoad;
-    size_t bytesRead;
+void BR_mapFileOrExitWithError(BufferReader* br, const char* sourceFilePath) {
+    int fd = open(sourceFilePath, O_RDONLY);
+    struct stat sourceStat;
+
+    if (fd == -1 || fstat(fd, &sourceStat) == -1) {
+        fprintf(stderr, "Lexer Error: Unable to open file \"%s\"\n", sourceFilePath);
+        exit(1);
+    }
+
+    br->mappedSize = sourceStat.st_size;
+    br->mappedData = NULL;
+
+    if (br->mappedSize > 0) {
+        br->mappedData = mmap(NULL, br->mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (br->mappedData == MAP_FAILED) {
+            fprintf(stderr, "Lexer Error: Unable to map file \"%s\"\n", sourceFilePath);
+            exit(1);
+        }
+
+        madvise(br->mappedData, br->mappedSize, MADV_SEQUENTIAL);
+    }
+
+    close(fd);
+}
+
+void BR_reserveLines(BufferReader* br, size_t count) {
+    if (br->linesSize + count <= br->linesCapacity)
+        return;
+
+    while (br->linesSize + count > br->linesCapacity)
+        br->linesCapacity *= 2;
+
+    br->lineStarts = realloc(br->lineStarts, sizeof(size_t) * br->linesCapacity);
+
+    if (br->lineStarts == NULL) {
+        fprintf(stderr, "Lexer Error: Unable to allocate %lu bytes\n", sizeof(size_t) * br->linesCapacity);
+        exit(1);
+    }
+}
+
+void BR_addLine(BufferReader* br, size_t lineStart) {
+    BR_reserveLines(br, 1);
+
+    br->lineStarts[br->linesSize] = lineStart;
+    br->linesSize++;
+}
+
+void BR_indexLines(BufferReader* br, const char* from, size_t len, size_t fromOffset) {
+    size_t i = 0;
+
+#ifdef __SSE2__
+    //16 bytes at a time, each bit of the mask is a new line
+    const __m128i newLines = _mm_set1_epi8('\n');
+
+    for (; i + 16 <= len; i += 16) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*) (from + i));
+        unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newLines));
+
+        if (mask == 0)
+            continue;
+
+        BR_reserveLines(br, 16);
+
+        while (mask != 0) {
+            br->lineStarts[br->linesSize] = fromOffset + i + __builtin_ctz(mask) + 1;
+            br->linesSize++;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i < len; i++) {
+        if (from[i] == '\n')
+            BR_addLine(br, fromOffset + i + 1);
+    }
+
+    br->indexedUntil = fromOffset + len;
+}
+
+void BR_indexLinesUntil(BufferReader* br, size_t offset) {
+    //Chunks of the double buffer are indexed when loaded, they are gone after that
+    if (br->sourceFile != NULL)
+        return;
+
+    const size_t size = br->end - br->regionStart;
+
+    //Index a step ahead, so the scan runs over big blocks and not token by token
+    if (offset < br->indexedUntil + BR_LINES_INDEX_STEP)
+        offset = br->indexedUntil + BR_LINES_INDEX_STEP;
+
+    if (offset > size)
+        offset = size;
+
+    if (offset > br->indexedUntil)
+        BR_indexLines(br, br->regionStart + br->indexedUntil, offset - br->indexedUntil, br->indexedUntil);
+}
+
+size_t BR_findLine(BufferReader* br, size_t offset, size_t low, size_t high) {
+    //Last line that starts at or before the offset, between low and high - 1
+    while (high - low > 1) {
+        const size_t middle = low + (high - low) / 2;
 
-    if (br->loadFirstPart)
-        startPositionToLoad = 0;
+        if (br->lineStarts[middle] <= offset)
+            low = middle;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+void BR_setLine(BufferReader* br, size_t line) {
+    br->lastLine = line;
+    br->lineStart = br->lineStarts[line];
+
+    //The line after the last indexed one is still unknown
+    if (line + 1 < br->linesSize)
+        br->nextLineStart = br->lineStarts[line + 1];
     else
-        startPositionToLoad = br->bufferSize;
+        br->nextLineStart = br->indexedUntil + 1;
+}
+
+void BR_findPosition(BufferReader* br, size_t offset) {
+    if (offset > br->indexedUntil)
+        BR_indexLinesUntil(br, offset);
+
+    size_t line = br->lastLine;
 
-    bytesRead = fread(br->buffer + startPositionToLoad, sizeof(char), br->bufferSize, br->sourceFile);
+    //Locations are mostly asked in order, so walk a few lines forward before searching
+    if (br->lineStarts[line] <= offset) {
+        size_t steps = 0;
+
+        while (line + 1 < br->linesSize && br->lineStarts[line + 1] <= offset) {
+            if (++steps > BR_LINES_WALK_LIMIT) {
+                line = BR_findLine(br, offset, line, br->linesSize);
+                break;
+            }
+
+            line++;
+        }
+    }
+    else
+        line = BR_findLine(br, offset, 0, line);
+
+    BR_setLine(br, line);
+}
+
+size_t BR_getOffset(BufferReader* br, const char* ptr) {
+    return br->regionOffset + (ptr - br->regionStart);
+}
+
+void BR_loadChunk(BufferReader* br, char* chunk) {
+    size_t bytesRead = fread(chunk, sizeof(char), br->bufferSize, br->sourceFile);
 
     if (bytesRead < br->bufferSize)
-        *(br->buffer + startPositionToLoad + bytesRead) = 0;
+        chunk[bytesRead] = 0;
+
+    BR_indexLines(br, chunk, bytesRead, br->regionOffset);
 
-    br->loadFirstPart = !br->loadFirstPart;
+    br->limit = chunk + br->bufferSize;
 }
 
-size_t BR_mod(size_t a, size_t b) {
-    size_t r = a % b;
-    
-    if (r < 0)
-        return r + b;
-    else
-        return r;
+void BR_crossLimit(BufferReader* br) {
+    br->regionOffset += br->bufferSize;
+
+    //Wrap around when the second half is over
+    if (br->limit == br->end)
+        br->current = br->buffer;
+
+    br->regionStart = br->current;
+
+    BR_loadChunk(br, (char*) br->current);
+}
+
+const char* BR_getRegionEnd(BufferReader* br) {
+    return br->limit != NULL ? br->limit : br->end;
+}
+
+bool BR_continueAfterScan(BufferReader* br) {
+    //The scan stopped at the limit, so the rest can be in the next chunk
+    if (br->current != br->limit)
+        return false;
+
+    BR_crossLimit(br);
+
+    return true;
 }
 
 void BR_finishSelection(BufferReader* br) {
-    br->startPtr = br->endPtr;
-    br->startPosition = br->endPosition;
+    br->selectionStart = br->current;
+    br->selectionStartOffset = BR_getOffset(br, br->current);
 }
 
-void BR_updateEndPosition(BufferReader* br, char ch) {
-    if (br->isNewLine) {
-        br->endPosition.line++;
-        br->endPosition.column = 1;
+BufferReader* BR_init() {
+    BufferReader* br = (BufferReader*) malloc(sizeof(BufferReader));
 
-        if (ch != '\n')
-            br->isNewLine = false;
-            
-        return;
+    if (br != NULL) {
+        br->sourceFile = NULL;
+        br->bufferSize = 0;
+        br->buffer = NULL;
+        br->mappedData = NULL;
+        br->mappedSize = 0;
+        br->limit = NULL;
+        br->regionOffset = 0;
+        br->scratch = NULL;
+        br->scratchSize = 0;
+
+        br->linesSize = 0;
+        br->linesCapacity = BR_INITIAL_LINES_CAPACITY;
+        br->lineStarts = BR_mallocOrExitWithError(sizeof(size_t) * br->linesCapacity);
+        br->indexedUntil = 0;
+
+        //The first line starts at the beginning of the file
+        BR_addLine(br, 0);
+        BR_setLine(br, 0);
     }
 
-    if (ch == '\n')
-        br->isNewLine = true;
+    return br;
+}
 
-    br->endPosition.column++;
+void BR_start(BufferReader* br) {
+    br->regionStart = br->current;
+    BR_finishSelection(br);
 }
 
 BufferReader* bufferReader_init(const char* sourceFilePath, size_t bufferSize) {
-    BufferReader* br = (BufferReader*) malloc(sizeof(BufferReader));
+    BufferReader* br = BR_init();
 
     if (br != NULL) {
         br->sourceFile = BR_openFileAsReadOrExitWithError(sourceFilePath);
@@ -99,84 +321,208 @@ BufferReader* bufferReader_init(const char* sourceFilePath, size_t bufferSize) {
         br->buffer = BR_mallocOrExitWithError(sizeof(char) * (bufferSize * 2));
         memset(br->buffer, 0, sizeof(char) * (bufferSize * 2));
 
-        br->loadFirstPart = true;
-        br->isNewLine = true;
+        br->current = br->buffer;
+        br->end = br->buffer + (bufferSize * 2);
+
+        BR_loadChunk(br, br->buffer);
+        BR_start(br);
+    }
+
+    return br;
+}
 
-        br->startPtr = 0;
-        br->endPtr = 0;
+BufferReader* bufferReader_initMapped(const char* sourceFilePath) {
+    BufferReader* br = BR_init();
 
-        FilePosition startFile =  {.line = 0, .column = 0};
-        br->startPosition = startFile;
-        br->endPosition = startFile;
+    if (br != NULL) {
+        BR_mapFileOrExitWithError(br, sourceFilePath);
 
-        BR_loadChunk(br);
-        BR_updateEndPosition(br, br->buffer[0]);
+        if (br->mappedData != NULL)
+            br->current = br->mappedData;
+        else
+            br->current = "";
+
+        br->end = br->current + br->mappedSize;
+
+        BR_start(br);
+    }
+
+    return br;
+}
+
+BufferReader* bufferReader_initFromMemory(const char* data, size_t size) {
+    BufferReader* br = BR_init();
+
+    if (br != NULL) {
+        br->current = data;
+        br->end = data + size;
+
+        BR_start(br);
     }
 
     return br;
 }
 
 void bufferReader_free(BufferReader* br) {
-    fclose(br->sourceFile);
+    if (br->sourceFile != NULL)
+        fclose(br->sourceFile);
+
+    if (br->mappedData != NULL)
+        munmap(br->mappedData, br->mappedSize);
+
     free(br->buffer);
+    free(br->scratch);
+    free(br->lineStarts);
     free(br);
 }
 
 bool bufferReader_isEOF(BufferReader* br) {
-    return br->buffer[br->endPtr] == 0;
+    return bufferReader_getCurrent(br) == 0;
 }
 
 void bufferReader_moveNext(BufferReader* br) {
-    br->endPtr = BR_mod(br->endPtr + 1, br->bufferSize * 2);
+    br->current++;
+
+    if (br->current == br->limit)
+        BR_crossLimit(br);
+}
+
+void bufferReader_moveUntilChar(BufferReader* br, char ch) {
+    do {
+        const char* regionEnd = BR_getRegionEnd(br);
+
+        if (br->current >= regionEnd)
+            return;
 
-    char current = bufferReader_getCurrent(br);
-    BR_updateEndPosition(br, current);
+        br->current = charScanner_findChar(br->current, regionEnd, ch);
+    } while (BR_continueAfterScan(br));
+}
+
+void bufferReader_moveUntilChars(BufferReader* br, char ch1, char ch2) {
+    do {
+        const char* regionEnd = BR_getRegionEnd(br);
+
+        if (br->current >= regionEnd)
+            return;
 
-    if (br->endPtr == 0 || br->endPtr == br->bufferSize)
-        BR_loadChunk(br);
+        br->current = charScanner_findChars(br->current, regionEnd, ch1, ch2);
+    } while (BR_continueAfterScan(br));
+}
+
+void bufferReader_moveWhileSpace(BufferReader* br) {
+    do {
+        const char* regionEnd = BR_getRegionEnd(br);
+
+        if (br->current >= regionEnd)
+            return;
+
+        br->current = charScanner_skipSpaces(br->current, regionEnd);
+    } while (BR_continueAfterScan(br));
 }
 
 char bufferReader_getCurrent(BufferReader* br) {
-    return br->buffer[br->endPtr];
+    if (br->current < br->end)
+        return *br->current;
+    else
+        return 0;
 }
 
 char* bufferReader_getSelected(BufferReader* br) {
-    size_t selectedLen;
-    char* selected;
+    BufferSlice slice = bufferReader_getSelectedSlice(br);
 
-    if (br->endPtr > br->startPtr)
-        selectedLen = br->endPtr - br->startPtr;
-    else
-        selectedLen = br->endPtr - br->startPtr + (br->bufferSize * 2);
+    char* selected = BR_mallocOrExitWithError(sizeof(char) * (slice.len + 1));
+    memcpy(selected, slice.str, slice.len);
+    selected[slice.len] = 0;
 
-    selected = BR_mallocOrExitWithError(sizeof(char) * (selectedLen + 1));
+    return selected;
+}
 
-    int i = br->startPtr;
-    int j = 0;
+BufferSlice bufferReader_getSelectedSlice(BufferReader* br) {
+    //The cursor can go past the end when a token is unfinished at EOF
+    const char* selectionEnd = br->current < br->end ? br->current : br->end;
+    BufferSlice slice;
 
-    while (i != br->endPtr) {
-        selected[j] = br->buffer[i];
-        
-        i = BR_mod(i + 1, br->bufferSize * 2);
-        j++;
+    if (selectionEnd >= br->selectionStart) {
+        slice.str = br->selectionStart;
+        slice.len = selectionEnd - br->selectionStart;
+    }
+    else {
+        //Selection wrapped around the double buffer, join both parts in the scratch
+        const size_t firstPartLen = br->end - br->selectionStart;
+        const size_t secondPartLen = selectionEnd - br->buffer;
+        slice.len = firstPartLen + secondPartLen;
+
+        if (slice.len > br->scratchSize) {
+            free(br->scratch);
+            br->scratch = BR_mallocOrExitWithError(sizeof(char) * slice.len);
+            br->scratchSize = slice.len;
+        }
+
+        memcpy(br->scratch, br->selectionStart, firstPartLen);
+        memcpy(br->scratch + firstPartLen, br->buffer, secondPartLen);
+        slice.str = br->scratch;
     }
-
-    selected[selectedLen] = 0;
 
     BR_finishSelection(br);
 
-    return selected;
+    return slice;
 }
 
 void bufferReader_ignoreSelected(BufferReader* br) {
     BR_finishSelection(br);
 }
 
-FileLocation bufferReader_getLocation(BufferReader* br) {
-    FileLocation location = {
-        .start = br->startPosition,
-        .end = br->endPosition,
+size_t bufferReader_getOffset(BufferReader* br) {
+    return BR_getOffset(br, br->current);
+}
+
+FilePosition bufferReader_getPosition(BufferReader* br, size_t offset) {
+    if (offset < br->lineStart || offset >= br->nextLineStart)
+        BR_findPosition(br, offset);
+
+    FilePosition position = {
+        .line = br->lastLine + 1,
+        .column = offset - br->lineStart + 1,
+        .offset = offset,
     };
 
+    return position;
+}
+
+FileLocation bufferReader_getLocation(BufferReader* br) {
+    const size_t startOffset = br->selectionStartOffset;
+    const size_t endOffset = bufferReader_getOffset(br);
+
+    if (startOffset < br->lineStart || startOffset >= br->nextLineStart)
+        BR_findPosition(br, startOffset);
+
+    FileLocation location;
+
+    location.start.line = br->lastLine + 1;
+    location.start.column = startOffset - br->lineStart + 1;
+    location.start.offset = startOffset;
+
+    //Most of the tokens end in the same line they start
+    if (endOffset >= br->nextLineStart)
+        BR_findPosition(br, endOffset);
+
+    location.end.line = br->lastLine + 1;
+    location.end.column = endOffset - br->lineStart + 1;
+    location.end.offset = endOffset;
+
     return location;
+}
+
+BufferSlice bufferReader_getSource(BufferReader* br) {
+    BufferSlice source = {
+        .str = NULL,
+        .len = 0,
+    };
+
+    if (br->sourceFile == NULL) {
+        source.str = br->regionStart;
+        source.len = br->end - br->regionStart;
+    }
+
+    return source;
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 typedef struct {
     size_t line;
     size_t column;
+    size_t offset;
 } FilePosition;
 
 typedef struct {
@@ -14,16 +15,33 @@ typedef struct {
     FilePosition end;
 } FileLocation;
 
+typedef struct {
+    const char* str;
+    size_t len;
+} BufferSlice;
+
 typedef struct bufferReader BufferReader;
 
 BufferReader* bufferReader_init(const char* sourceFilePath, size_t bufferSize);
+BufferReader* bufferReader_initMapped(const char* sourceFilePath);
+//Reads a region of memory owned by the caller, it must outlive the reader
+BufferReader* bufferReader_initFromMemory(const char* data, size_t size);
 void bufferReader_free(BufferReader* br);
 
 bool bufferReader_isEOF(BufferReader* br);
 void bufferReader_moveNext(BufferReader* br);
+//Bulk moves, they stop at the first matching char (or at the first not space char) or at EOF
+void bufferReader_moveUntilChar(BufferReader* br, char ch);
+void bufferReader_moveUntilChars(BufferReader* br, char ch1, char ch2);
+void bufferReader_moveWhileSpace(BufferReader* br);
 char bufferReader_getCurrent(BufferReader* br);
 char* bufferReader_getSelected(BufferReader* br);
+BufferSlice bufferReader_getSelectedSlice(BufferReader* br);
 void bufferReader_ignoreSelected(BufferReader* br);
+size_t bufferReader_getOffset(BufferReader* br);
+FilePosition bufferReader_getPosition(BufferReader* br, size_t offset);
 FileLocation bufferReader_getLocation(BufferReader* br);
+//Whole source, only available in the mapped and memory modes (len is 0 in the double buffer mode)
+BufferSlice bufferReader_getSource(BufferReader* br);
 
 #endif
\ No newline at end of file
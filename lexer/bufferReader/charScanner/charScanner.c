@@ -0,0 +1,213 @@
+#include "charScanner.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CS_X86
+#include <immintrin.h>
+#endif
+
+/*
+    Each kernel has a scalar version, that is also used for the tail of the
+    region, a SSE2 version (always available on x86-64) and an AVX2 version
+    that is picked at runtime when the CPU supports it.
+*/
+
+#pragma region SCALAR
+
+bool CS_isSpace(char ch) {
+    //Same chars as isspace in the C locale
+    return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
+
+const char* CS_findCharScalar(const char* from, const char* to, char ch) {
+    for (; from < to; from++) {
+        if (*from == ch || *from == 0)
+            return from;
+    }
+
+    return to;
+}
+
+const char* CS_findCharsScalar(const char* from, const char* to, char ch1, char ch2) {
+    for (; from < to; from++) {
+        if (*from == ch1 || *from == ch2 || *from == 0)
+            return from;
+    }
+
+    return to;
+}
+
+const char* CS_skipSpacesScalar(const char* from, const char* to) {
+    for (; from < to; from++) {
+        if (!CS_isSpace(*from))
+            return from;
+    }
+
+    return to;
+}
+
+#pragma endregion
+
+#ifdef CS_X86
+
+#pragma region SSE2
+
+static inline __m128i CS_matchSpacesSSE2(__m128i chunk) {
+    //'\t' to '\r' are the chars where (ch - '\t') <= 4 as unsigned
+    const __m128i shifted = _mm_sub_epi8(chunk, _mm_set1_epi8('\t'));
+    const __m128i isControlSpace = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+
+    return _mm_or_si128(isControlSpace, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')));
+}
+
+const char* CS_findCharSSE2(const char* from, const char* to, char ch) {
+    const __m128i chs = _mm_set1_epi8(ch);
+    const __m128i zeros = _mm_setzero_si128();
+
+    for (; to - from >= 16; from += 16) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*) from);
+        const __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(chunk, chs), _mm_cmpeq_epi8(chunk, zeros));
+        const unsigned int mask = _mm_movemask_epi8(matches);
+
+        if (mask != 0)
+            return from + __builtin_ctz(mask);
+    }
+
+    return CS_findCharScalar(from, to, ch);
+}
+
+const char* CS_findCharsSSE2(const char* from, const char* to, char ch1, char ch2) {
+    const __m128i chs1 = _mm_set1_epi8(ch1);
+    const __m128i chs2 = _mm_set1_epi8(ch2);
+    const __m128i zeros = _mm_setzero_si128();
+
+    for (; to - from >= 16; from += 16) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*) from);
+        const __m128i matches = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, chs1), _mm_cmpeq_epi8(chunk, chs2)),
+            _mm_cmpeq_epi8(chunk, zeros));
+        const unsigned int mask = _mm_movemask_epi8(matches);
+
+        if (mask != 0)
+            return from + __builtin_ctz(mask);
+    }
+
+    return CS_findCharsScalar(from, to, ch1, ch2);
+}
+
+const char* CS_skipSpacesSSE2(const char* from, const char* to) {
+    for (; to - from >= 16; from += 16) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*) from);
+        const unsigned int mask = ~_mm_movemask_epi8(CS_matchSpacesSSE2(chunk)) & 0xFFFF;
+
+        if (mask != 0)
+            return from + __builtin_ctz(mask);
+    }
+
+    return CS_skipSpacesScalar(from, to);
+}
+
+#pragma endregion
+
+#pragma region AVX2
+
+__attribute__((target("avx2")))
+static inline __m256i CS_matchSpacesAVX2(__m256i chunk) {
+    const __m256i shifted = _mm256_sub_epi8(chunk, _mm256_set1_epi8('\t'));
+    const __m256i isControlSpace = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(4)), shifted);
+
+    return _mm256_or_si256(isControlSpace, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')));
+}
+
+__attribute__((target("avx2")))
+const char* CS_findCharAVX2(const char* from, const char* to, char ch) {
+    const __m256i chs = _mm256_set1_epi8(ch);
+    const __m256i zeros = _mm256_setzero_si256();
+
+    for (; to - from >= 32; from += 32) {
+        const __m256i chunk = _mm256_loadu_si256((const __m256i*) from);
+        const __m256i matches = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, chs), _mm256_cmpeq_epi8(chunk, zeros));
+        const unsigned int mask = _mm256_movemask_epi8(matches);
+
+        if (mask != 0)
+            return from + __builtin_ctz(mask);
+    }
+
+    return CS_findCharSSE2(from, to, ch);
+}
+
+__attribute__((target("avx2")))
+const char* CS_findCharsAVX2(const char* from, const char* to, char ch1, char ch2) {
+    const __m256i chs1 = _mm256_set1_epi8(ch1);
+    const __m256i chs2 = _mm256_set1_epi8(ch2);
+    const __m256i zeros = _mm256_setzero_si256();
+
+    for (; to - from >= 32; from += 32) {
+        const __m256i chunk = _mm256_loadu_si256((const __m256i*) from);
+        const __m256i matches = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, chs1), _mm256_cmpeq_epi8(chunk, chs2)),
+            _mm256_cmpeq_epi8(chunk, zeros));
+        const unsigned int mask = _mm256_movemask_epi8(matches);
+
+        if (mask != 0)
+            return from + __builtin_ctz(mask);
+    }
+
+    return CS_findCharsSSE2(from, to, ch1, ch2);
+}
+
+__attribute__((target("avx2")))
+const char* CS_skipSpacesAVX2(const char* from, const char* to) {
+    for (; to - from >= 32; from += 32) {
+        const __m256i chunk = _mm256_loadu_si256((const __m256i*) from);
+        const unsigned int mask = ~_mm256_movemask_epi8(CS_matchSpacesAVX2(chunk));
+
+        if (mask != 0)
+            return from + __builtin_ctz(mask);
+    }
+
+    return CS_skipSpacesSSE2(from, to);
+}
+
+#pragma endregion
+
+bool CS_hasAVX2() {
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+const char* charScanner_findChar(const char* from, const char* to, char ch) {
+#ifdef CS_X86
+    if (CS_hasAVX2())
+        return CS_findCharAVX2(from, to, ch);
+    else
+        return CS_findCharSSE2(from, to, ch);
+#else
+    return CS_findCharScalar(from, to, ch);
+#endif
+}
+
+const char* charScanner_findChars(const char* from, const char* to, char ch1, char ch2) {
+#ifdef CS_X86
+    if (CS_hasAVX2())
+        return CS_findCharsAVX2(from, to, ch1, ch2);
+    else
+        return CS_findCharsSSE2(from, to, ch1, ch2);
+#else
+    return CS_findCharsScalar(from, to, ch1, ch2);
+#endif
+}
+
+const char* charScanner_skipSpaces(const char* from, const char* to) {
+#ifdef CS_X86
+    if (CS_hasAVX2())
+        return CS_skipSpacesAVX2(from, to);
+    else
+        return CS_skipSpacesSSE2(from, to);
+#else
+    return CS_skipSpacesScalar(from, to);
+#endif
+}
\ No newline at end of file
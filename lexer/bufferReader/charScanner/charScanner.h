@@ -0,0 +1,14 @@
+#ifndef CHAR_SCANNER_H
+#define CHAR_SCANNER_H
+
+/*
+    Kernels that scan a contiguous region [from, to) 16 (SSE2) or 32 (AVX2) bytes
+    at a time, with a scalar fallback. All of them also stop at a 0, that is the
+    EOF mark of the BufferReader, and return "to" when nothing was found.
+*/
+
+const char* charScanner_findChar(const char* from, const char* to, char ch);
+const char* charScanner_findChars(const char* from, const char* to, char ch1, char ch2);
+const char* charScanner_skipSpaces(const char* from, const char* to);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,380 @@
+#include "incrementalLexer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#define IL_INITIAL_SOURCE_CAPACITY 4096
+#define IL_INITIAL_TOKENS_CAPACITY 1024
+//The Symbols Table is rebuilt with only the live names when it gets twice as big as them (and over this)
+#define IL_MIN_SYMBOLS_LIMIT 1024
+
+//The new Tokens of an edit are lexed into the pending ones first
+struct tokens {
+    Token* tokens;
+    size_t count;
+    size_t capacity;
+};
+
+struct incrementalLexer {
+    char* source;
+    size_t sourceSize;
+    size_t sourceCapacity;
+    struct tokens current;
+    struct tokens pending;
+    SymbolsTable* symbolsTable;
+    size_t symbolsLimit;
+    bool hasError;
+    FilePosition errorAfter;
+};
+
+void* IL_mallocOrExitWithError(size_t size) {
+    void* m = malloc(size);
+
+    if (m == NULL) {
+        fprintf(stderr, "Incremental Lexer Error: Unable to allocate %lu bytes\n", size);
+        exit(1);
+    }
+
+    return m;
+}
+
+void* IL_reallocOrExitWithError(void* m, size_t size) {
+    m = realloc(m, size);
+
+    if (m == NULL) {
+        fprintf(stderr, "Incremental Lexer Error: Unable to allocate %lu bytes\n", size);
+        exit(1);
+    }
+
+    return m;
+}
+
+#pragma region TOKENS
+
+void IL_initTokens(struct tokens* ts) {
+    ts->count = 0;
+    ts->capacity = IL_INITIAL_TOKENS_CAPACITY;
+    ts->tokens = IL_mallocOrExitWithError(sizeof(Token) * ts->capacity);
+}
+
+void IL_reserveTokens(struct tokens* ts, size_t count) {
+    if (count <= ts->capacity)
+        return;
+
+    while (count > ts->capacity)
+        ts->capacity *= 2;
+
+    ts->tokens = IL_reallocOrExitWithError(ts->tokens, sizeof(Token) * ts->capacity);
+}
+
+//First Token that ends at or after the offset (it can grow with what is inserted there)
+size_t IL_findFirstTouched(const struct tokens* ts, size_t offset) {
+    size_t low = 0, high = ts->count;
+
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+
+        if (ts->tokens[middle].location.end.offset < offset)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+bool IL_isSameToken(const Token* a, const Token* b) {
+    if (a->type != b->type)
+        return false;
+
+    if (a->type == V_NUM_FLOAT)
+        return a->attribute.FLOAT_ATTR == b->attribute.FLOAT_ATTR;
+
+    return a->attribute.INT_ATTR == b->attribute.INT_ATTR;
+}
+
+void IL_shiftPosition(FilePosition* position, const TokenEdit* edit, long offsetDelta) {
+    if (position->line == edit->shiftedLine)
+        position->column += edit->columnDelta;
+
+    position->line += edit->lineDelta;
+    position->offset += offsetDelta;
+}
+
+#pragma endregion
+
+#pragma region LEXING
+
+void IL_editSource(IncrementalLexer* il, size_t offset, size_t deletedSize, const char* inserted, size_t insertedSize) {
+    const size_t newSize = il->sourceSize - deletedSize + insertedSize;
+
+    if (newSize + 1 > il->sourceCapacity) {
+        while (newSize + 1 > il->sourceCapacity)
+            il->sourceCapacity *= 2;
+
+        il->source = IL_reallocOrExitWithError(il->source, il->sourceCapacity);
+    }
+
+    memmove(il->source + offset + insertedSize, il->source + offset + deletedSize,
+            il->sourceSize - offset - deletedSize);
+    memcpy(il->source + offset, inserted, insertedSize);
+
+    il->sourceSize = newSize;
+    il->source[il->sourceSize] = 0;
+}
+
+//The Lexer starts at line 1, column 1 and offset 0 from the restart
+FilePosition IL_toAbsolute(FilePosition relative, FilePosition base) {
+    FilePosition absolute = {
+        .line = base.line + relative.line - 1,
+        .column = relative.line == 1 ? base.column + relative.column - 1 : relative.column,
+        .offset = base.offset + relative.offset,
+    };
+
+    return absolute;
+}
+
+/*
+    The loop of IL_lexUntilSynced, in a function of its own so nothing it
+    changes is a local of the function of the setjmp (clobbered by the longjmp).
+*/
+void IL_lexTokens(IncrementalLexer* il, Lexer* l, FilePosition restart,
+                  size_t oldEditEnd, size_t newEditEnd, size_t candidate, size_t* synced) {
+
+    struct tokens* old = &il->current;
+    struct tokens* pending = &il->pending;
+    Token t;
+
+    while ((t = lexer_getNextToken(l)).type != E_EOF) {
+        t.location.start = IL_toAbsolute(t.location.start, restart);
+        t.location.end = IL_toAbsolute(t.location.end, restart);
+
+        const size_t start = t.location.start.offset;
+        const size_t end = t.location.end.offset;
+
+        //Old Tokens out of the edit, where the new ones can meet them again
+        if (start >= newEditEnd) {
+            const size_t oldStart = start - newEditEnd + oldEditEnd;
+
+            while (candidate < old->count && (old->tokens[candidate].location.start.offset < oldEditEnd ||
+                                              old->tokens[candidate].location.start.offset < oldStart))
+                candidate++;
+
+            const FileLocation* oldLocation = candidate < old->count ? &old->tokens[candidate].location : NULL;
+
+            if (oldLocation != NULL && oldLocation->start.offset == oldStart &&
+                oldLocation->end.offset - oldStart == end - start && IL_isSameToken(&old->tokens[candidate], &t)) {
+
+                *synced = candidate;
+                pending->tokens[pending->count] = t;
+                return;
+            }
+        }
+
+        IL_reserveTokens(pending, pending->count + 2);
+
+        pending->tokens[pending->count++] = t;
+    }
+}
+
+/*
+    Lexes from the restart offset into the pending Tokens, until the end or
+    a new Token after the edit is one of the old ones (synced, its index is
+    set). Returns false when it stopped at an error.
+*/
+bool IL_lexUntilSynced(IncrementalLexer* il, FilePosition restart,
+                       size_t oldEditEnd, size_t newEditEnd, size_t firstCandidate, size_t* synced) {
+
+    jmp_buf errorHandler;
+
+    Lexer* l = lexer_initFromMemory(il->source + restart.offset, il->sourceSize - restart.offset, il->symbolsTable);
+    lexer_setErrorHandler(l, &errorHandler);
+
+    il->pending.count = 0;
+    *synced = il->current.count;
+
+    //The pending Tokens are in the heap, so the ones before an error are kept
+    if (setjmp(errorHandler) != 0) {
+        lexer_free(l);
+        return false;
+    }
+
+    IL_lexTokens(il, l, restart, oldEditEnd, newEditEnd, firstCandidate, synced);
+
+    lexer_free(l);
+
+    return true;
+}
+
+/*
+    Each edit adds the names it lexes (a, ab, abc... while typing) and they
+    are never removed, so the table is made again from the names of the
+    Tokens, in the order of their first use (the ids of a fresh lexing).
+*/
+void IL_rebuildSymbolsTable(IncrementalLexer* il) {
+    SymbolsTable* old = il->symbolsTable;
+    SymbolsTable* rebuilt = symbolsTable_init();
+    const size_t oldSize = symbolsTable_getSize(old);
+
+    size_t* newIds = IL_mallocOrExitWithError(sizeof(size_t) * (oldSize + 1));
+    memset(newIds, 0, sizeof(size_t) * (oldSize + 1));
+
+    for (size_t i = 0; i < il->current.count; i++) {
+        Token* t = &il->current.tokens[i];
+
+        if (t->type != I_ID && t->type != V_STRING)
+            continue;
+
+        const size_t oldId = t->attribute.INT_ATTR;
+
+        if (newIds[oldId] == 0) {
+            newIds[oldId] = symbolsTable_getIdOrAddSymbolWithLength(rebuilt,
+                symbolsTable_getName(old, oldId), symbolsTable_getNameLength(old, oldId));
+        }
+
+        t->attribute.INT_ATTR = newIds[oldId];
+    }
+
+    free(newIds);
+    symbolsTable_free(old);
+
+    il->symbolsTable = rebuilt;
+    il->symbolsLimit = 2 * symbolsTable_getSize(rebuilt);
+
+    if (il->symbolsLimit < IL_MIN_SYMBOLS_LIMIT)
+        il->symbolsLimit = IL_MIN_SYMBOLS_LIMIT;
+}
+
+#pragma endregion
+
+IncrementalLexer* incrementalLexer_init() {
+    IncrementalLexer* il = (IncrementalLexer*) malloc(sizeof(IncrementalLexer));
+
+    if (il != NULL) {
+        il->sourceCapacity = IL_INITIAL_SOURCE_CAPACITY;
+        il->source = IL_mallocOrExitWithError(sizeof(char) * il->sourceCapacity);
+        il->source[0] = 0;
+        il->sourceSize = 0;
+
+        IL_initTokens(&il->current);
+        IL_initTokens(&il->pending);
+
+        il->symbolsTable = symbolsTable_init();
+        il->symbolsLimit = IL_MIN_SYMBOLS_LIMIT;
+        il->hasError = false;
+    }
+
+    return il;
+}
+
+void incrementalLexer_free(IncrementalLexer* il) {
+    free(il->source);
+    free(il->current.tokens);
+    free(il->pending.tokens);
+    symbolsTable_free(il->symbolsTable);
+    free(il);
+}
+
+bool incrementalLexer_edit(IncrementalLexer* il, size_t offset, size_t deletedSize,
+                           const char* inserted, size_t insertedSize, TokenEdit* edit) {
+
+    if (offset > il->sourceSize || deletedSize > il->sourceSize - offset)
+        return false;
+
+    struct tokens* current = &il->current;
+    struct tokens* pending = &il->pending;
+    const size_t oldCount = current->count;
+
+    //One Token before the first touched one, it can end differently with what comes after it
+    const size_t touched = IL_findFirstTouched(current, offset);
+    const size_t first = touched > 0 ? touched - 1 : 0;
+
+    FilePosition restart = { .line = 1, .column = 1, .offset = 0 };
+
+    if (touched > 0)
+        restart = current->tokens[first].location.start;
+
+    IL_editSource(il, offset, deletedSize, inserted, insertedSize);
+
+    size_t synced;
+    const bool isLexed = IL_lexUntilSynced(il, restart, offset + deletedSize, offset + insertedSize, touched, &synced);
+
+    const bool isSynced = synced < current->count;
+
+    edit->start = first;
+    edit->deleted = synced - first;
+    edit->inserted = pending->count;
+    edit->lineDelta = 0;
+    edit->shiftedLine = 0;
+    edit->columnDelta = 0;
+
+    //The new Token that met the old one was left after the pending ones
+    if (isSynced) {
+        const FilePosition newStart = pending->tokens[pending->count].location.start;
+        const FilePosition oldStart = current->tokens[synced].location.start;
+
+        edit->lineDelta = (long) newStart.line - (long) oldStart.line;
+        edit->shiftedLine = oldStart.line;
+        edit->columnDelta = (long) newStart.column - (long) oldStart.column;
+    }
+
+    //The kept Tokens move to after the new ones
+    const size_t keptCount = current->count - synced;
+    const size_t newCount = first + pending->count + keptCount;
+    const size_t keptStart = first + pending->count;
+    const long offsetDelta = (long) insertedSize - (long) deletedSize;
+
+    IL_reserveTokens(current, newCount);
+
+    memmove(current->tokens + keptStart, current->tokens + synced, sizeof(Token) * keptCount);
+    memcpy(current->tokens + first, pending->tokens, sizeof(Token) * pending->count);
+
+    for (size_t i = keptStart; i < newCount; i++) {
+        IL_shiftPosition(&current->tokens[i].location.start, edit, offsetDelta);
+        IL_shiftPosition(&current->tokens[i].location.end, edit, offsetDelta);
+    }
+
+    current->count = newCount;
+
+    //The ids of the Tokens change, so every one of them is replaced
+    if (symbolsTable_getSize(il->symbolsTable) > il->symbolsLimit) {
+        IL_rebuildSymbolsTable(il);
+
+        edit->start = 0;
+        edit->deleted = oldCount;
+        edit->inserted = current->count;
+    }
+
+    //Synced, the error (if any) is still after the kept Tokens, else it is where the lexing stopped
+    if (isSynced) {
+        if (il->hasError)
+            IL_shiftPosition(&il->errorAfter, edit, offsetDelta);
+    }
+    else {
+        il->hasError = !isLexed;
+
+        if (il->hasError)
+            il->errorAfter = current->count > 0 ? current->tokens[current->count - 1].location.end : restart;
+    }
+
+    edit->hasError = il->hasError;
+    edit->errorAfter = il->errorAfter;
+
+    return true;
+}
+
+const Token* incrementalLexer_getTokens(IncrementalLexer* il, size_t* tokensCount) {
+    *tokensCount = il->current.count;
+
+    return il->current.tokens;
+}
+
+SymbolsTable* incrementalLexer_getSymbolsTable(IncrementalLexer* il) {
+    return il->symbolsTable;
+}
+
+size_t incrementalLexer_getSourceSize(IncrementalLexer* il) {
+    return il->sourceSize;
+}
\ No newline at end of file
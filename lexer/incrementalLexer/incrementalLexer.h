@@ -0,0 +1,49 @@
+#ifndef INCREMENTAL_LEXER_H
+#define INCREMENTAL_LEXER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "../lexer.h"
+#include "../../symbolsTable/symbolsTable.h"
+
+/*
+    Keeps a source, its Tokens and its Symbols Table across edits: an edit
+    only lexes again from the Token before it until the new Tokens are the
+    old ones again (same offsets, type and attribute), the Tokens after that
+    are kept and only moved.
+    The lexer errors don't end the program, the Tokens stop before them.
+    The names no Token uses anymore are dropped from the Symbols Table once
+    in a while, changing the ids: that edit replaces every Token.
+*/
+typedef struct incrementalLexer IncrementalLexer;
+
+/*
+    The old Tokens [start, start + deleted) were replaced by [start, start + inserted).
+    The Tokens after them moved lineDelta lines, and the positions that were
+    in shiftedLine (before moving) also moved columnDelta columns.
+*/
+typedef struct {
+    size_t start;
+    size_t deleted;
+    size_t inserted;
+    long lineDelta;
+    size_t shiftedLine;
+    long columnDelta;
+    //The Tokens end at an error somewhere after this position
+    bool hasError;
+    FilePosition errorAfter;
+} TokenEdit;
+
+IncrementalLexer* incrementalLexer_init();
+void incrementalLexer_free(IncrementalLexer* il);
+
+//Replaces deletedSize bytes at offset with the inserted ones, false (and nothing changes) when out of the source
+bool incrementalLexer_edit(IncrementalLexer* il, size_t offset, size_t deletedSize,
+                           const char* inserted, size_t insertedSize, TokenEdit* edit);
+
+const Token* incrementalLexer_getTokens(IncrementalLexer* il, size_t* tokensCount);
+SymbolsTable* incrementalLexer_getSymbolsTable(IncrementalLexer* il);
+size_t incrementalLexer_getSourceSize(IncrementalLexer* il);
+
+#endif
\ No newline at end of file
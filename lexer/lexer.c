@@ -4,42 +4,133 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdbool.h>
-#include <ctype.h>
 #include <string.h>
 #include <stdarg.h>
+#include <limits.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #include "bufferReader/bufferReader.h"
+#include "bufferReader/charScanner/charScanner.h"
+#include "tokenStream/tokenStream.h"
 #include "../symbolsTable/symbolsTable.h"
+#include "reservedWords/reservedWordsTable.h"
+
+/*
+    Perfect hash table of the reserved words, generated at build time from
+    reservedWords/reservedWords.def, empty slots have len 0 and never match
+*/
 const struct LX_s_reservedWords {
     char* str;
+    size_t len;
     enum tokenType type;
-} LX_reservedWords[] = {
-    {.str = "void", .type = R_VOID},
-    {.str = "main", .type = R_MAIN},
-    {.str = "if", .type = R_IF},
-    {.str = "else", .type = R_ELSE},
-    {.str = "for", .type = R_FOR},
-    {.str = "while", .type = R_WHILE},
-    {.str = "int", .type = R_INT},
-    {.str = "float", .type = R_FLOAT},
-    {.str = "char", .type = R_CHAR},
-    {.str = "scanf", .type = R_SCANF},
-    {.str = "print", .type = R_PRINT},
-    {.str = "return", .type = R_RETURN},
+} LX_reservedWords[1 << LX_RESERVED_WORDS_BITS] = {
+    LX_RESERVED_WORDS_TABLE
+};
+
+/*
+    Class of each char, used by the start state of lexer_getNextToken and by the
+    inner loops, so each test is a single load and not a (locale aware) ctype call.
+    The chars out of ASCII are left as 0, that is LX_CHAR_OTHER, and skipped.
+*/
+enum LX_charClass {
+    LX_CHAR_OTHER = 0,
+    LX_CHAR_SPACE,
+    LX_CHAR_DIGIT,
+    LX_CHAR_LETTER,
+    LX_CHAR_UNDERSCORE,
+    LX_CHAR_SYMBOL,
+    LX_CHAR_QUOTE,
+    LX_CHAR_PLUS,
+    LX_CHAR_MINUS,
+    LX_CHAR_ASTERISK,
+    LX_CHAR_SLASH,
+    LX_CHAR_PERCENTAGE,
+    LX_CHAR_EQUAL,
+    LX_CHAR_GREATER,
+    LX_CHAR_LESS,
+};
+
+#define OT LX_CHAR_OTHER
+#define SP LX_CHAR_SPACE
+#define DI LX_CHAR_DIGIT
+#define LE LX_CHAR_LETTER
+#define UN LX_CHAR_UNDERSCORE
+#define SY LX_CHAR_SYMBOL
+#define QU LX_CHAR_QUOTE
+#define PL LX_CHAR_PLUS
+#define MI LX_CHAR_MINUS
+#define AS LX_CHAR_ASTERISK
+#define SL LX_CHAR_SLASH
+#define PE LX_CHAR_PERCENTAGE
+#define EQ LX_CHAR_EQUAL
+#define GR LX_CHAR_GREATER
+#define LS LX_CHAR_LESS
+
+const uint8_t LX_charClasses[256] = {
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, SP, SP, SP, SP, SP, OT, OT,
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,
+    SP, SY, QU, SY, SY, PE, SY, SY, SY, SY, AS, PL, SY, MI, SY, SL,
+    DI, DI, DI, DI, DI, DI, DI, DI, DI, DI, SY, SY, LS, EQ, GR, SY,
+    SY, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE,
+    LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, SY, SY, SY, SY, UN,
+    SY, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE,
+    LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, SY, SY, SY, SY, OT,
 };
 
-const size_t LX_sizeReservedWords = 
-    sizeof(LX_reservedWords) / sizeof(struct LX_s_reservedWords);
+#undef OT
+#undef SP
+#undef DI
+#undef LE
+#undef UN
+#undef SY
+#undef QU
+#undef PL
+#undef MI
+#undef AS
+#undef SL
+#undef PE
+#undef EQ
+#undef GR
+#undef LS
+
+static inline enum LX_charClass LX_getCharClass(char ch) {
+    return LX_charClasses[(unsigned char) ch];
+}
+
+static inline bool LX_isDigit(char ch) {
+    return LX_getCharClass(ch) == LX_CHAR_DIGIT;
+}
+
+static inline bool LX_isLetter(char ch) {
+    return LX_getCharClass(ch) == LX_CHAR_LETTER;
+}
+
+static inline bool LX_isNameChar(char ch) {
+    const enum LX_charClass charClass = LX_getCharClass(ch);
+
+    return charClass == LX_CHAR_DIGIT || charClass == LX_CHAR_LETTER || charClass == LX_CHAR_UNDERSCORE;
+}
 
 struct lexer {
     BufferReader* bufferReader;
     SymbolsTable* symbolsTable;  
+    //When set, the errors jump here instead of ending the program
+    jmp_buf* errorHandler;
+    FilePosition errorPosition;
 };
 
 void LX_throwError(Lexer *l, const char* msg, ...) {
     bufferReader_ignoreSelected(l->bufferReader);
     FileLocation errorPosition = bufferReader_getLocation(l->bufferReader);
 
+    if (l->errorHandler != NULL) {
+        l->errorPosition = errorPosition.start;
+        longjmp(*l->errorHandler, 1);
+    }
+
     fprintf(stderr, "Lexer Error -> L:%ld C:%ld: ",
         errorPosition.start.line, errorPosition.start.column);
 
@@ -54,14 +145,59 @@ void LX_throwError(Lexer *l, const char* msg, ...) {
 
 #pragma region NUMBER
 
+#define LX_NUMBER_MAX_LEN 64
+
+//Same result as strtoll for a slice with only digits, saturating on overflow
+long long LX_sliceToInt(BufferSlice slice) {
+    long long value = 0;
+
+    for (size_t i = 0; i < slice.len; i++) {
+        const int digit = slice.str[i] - '0';
+
+        if (value > (LLONG_MAX - digit) / 10)
+            return LLONG_MAX;
+
+        value = value * 10 + digit;
+    }
+
+    return value;
+}
+
+double LX_sliceToFloat(BufferSlice slice) {
+    //strtod needs a terminated string, the slice is only a view of the reader
+    char number[LX_NUMBER_MAX_LEN];
+    char* str = number;
+
+    if (slice.len >= LX_NUMBER_MAX_LEN) {
+        str = malloc(sizeof(char) * (slice.len + 1));
+
+        if (str == NULL) {
+            fprintf(stderr, "Lexer Error: Unable to allocate %lu bytes\n", slice.len + 1);
+            exit(1);
+        }
+    }
+
+    memcpy(str, slice.str, slice.len);
+    str[slice.len] = 0;
+
+    double value = strtod(str, NULL);
+
+    if (str != number)
+        free(str);
+
+    return value;
+}
+
 void LX_moveWhileIsNumber(Lexer* l) {
-    while (!bufferReader_isEOF(l->bufferReader) && isdigit(bufferReader_getCurrent(l->bufferReader))) {
+    char current = bufferReader_getCurrent(l->bufferReader);
+
+    //The EOF mark is not a digit, so it also ends the loop
+    while (LX_isDigit(current)) {
         bufferReader_moveNext(l->bufferReader);
+        current = bufferReader_getCurrent(l->bufferReader);
     }
-    
-    const char current = bufferReader_getCurrent(l->bufferReader);
 
-    if (isalpha(current))
+    if (LX_isLetter(current))
         LX_throwError(l, "Expected a number or '.', but found a letter '%c'\n", current);
 }
 
@@ -70,35 +206,33 @@ Token LX_getFloatNumber(Lexer *l) {
 
     char current = bufferReader_getCurrent(l->bufferReader);
 
-    if (!isdigit(current))
+    if (!LX_isDigit(current))
         LX_throwError(l, "Expected a number after '.', but found '%c'\n", current);
 
     LX_moveWhileIsNumber(l);
 
     FileLocation location = bufferReader_getLocation(l->bufferReader);
-    char *str = bufferReader_getSelected(l->bufferReader);
+    BufferSlice slice = bufferReader_getSelectedSlice(l->bufferReader);
     
     Token t = {
         .type = V_NUM_FLOAT,
-        .attribute.FLOAT_ATTR = strtod(str, NULL),
+        .attribute.FLOAT_ATTR = LX_sliceToFloat(slice),
         .location = location
     };
 
-    free(str);
     return t;
 }
 
 Token LX_getIntNumber(Lexer *l) {
     FileLocation location = bufferReader_getLocation(l->bufferReader);
-    char *str = bufferReader_getSelected(l->bufferReader);
+    BufferSlice slice = bufferReader_getSelectedSlice(l->bufferReader);
 
     Token t = {
         .type = V_NUM_INT,
-        .attribute.INT_ATTR = strtoll(str, NULL, 10),
+        .attribute.INT_ATTR = LX_sliceToInt(slice),
         .location = location
     };
 
-    free(str);
     return t;
 }
 
@@ -118,40 +252,43 @@ Token LX_getNumber(Lexer *l) {
 
 #pragma region NAME
 
-enum tokenType LX_getNameType(char* str) {
-    for (int i = 0; i < LX_sizeReservedWords; i++) {
-        const struct LX_s_reservedWords reservedWord = LX_reservedWords[i];
+enum tokenType LX_getNameType(BufferSlice slice, uint32_t hash) {
+    const uint32_t slot = (uint32_t) (hash * LX_RESERVED_WORDS_SEED) >> (32 - LX_RESERVED_WORDS_BITS);
+    const struct LX_s_reservedWords *reservedWord = &LX_reservedWords[slot];
 
-        if (strcmp(reservedWord.str, str) == 0)
-            return reservedWord.type;
-    }
+    if (reservedWord->len == slice.len && memcmp(reservedWord->str, slice.str, slice.len) == 0)
+        return reservedWord->type;
 
     return I_ID;
 }
 
 Token LX_getName(Lexer *l) {
-    bufferReader_moveNext(l->bufferReader);
+    char current = bufferReader_getCurrent(l->bufferReader);
+    uint64_t hash = SYMBOLS_TABLE_HASH_INIT;
+
+    //Hash the name while reading it, the same hash is used by the reserved words and the symbols table
+    do {
+        hash = symbolsTable_hashStep(hash, current);
 
-    while (!bufferReader_isEOF(l->bufferReader) && 
-            (isalnum(bufferReader_getCurrent(l->bufferReader)) || bufferReader_getCurrent(l->bufferReader) == '_')) {
         bufferReader_moveNext(l->bufferReader);
-    }
+        current = bufferReader_getCurrent(l->bufferReader);
+    } while (LX_isNameChar(current));
+
+    const uint32_t nameHash = symbolsTable_hashFinish(hash);
 
     FileLocation location = bufferReader_getLocation(l->bufferReader);
-    char *str = bufferReader_getSelected(l->bufferReader);
+    BufferSlice slice = bufferReader_getSelectedSlice(l->bufferReader);
 
     Token t = {
-        .type = LX_getNameType(str),
+        .type = LX_getNameType(slice, nameHash),
         .location = location,
     };
     
     if (t.type == I_ID)
-        t.attribute.INT_ATTR = symbolsTable_getIdOrAddSymbol(l->symbolsTable, str);
+        t.attribute.INT_ATTR = symbolsTable_getIdOrAddHashedSymbol(l->symbolsTable, slice.str, slice.len, nameHash);
     else
         t.attribute.INT_ATTR = 0;
 
-    free(str);
-
     return t;
 }
 
@@ -161,30 +298,21 @@ Token LX_getName(Lexer *l) {
 
 Token LX_getString(Lexer *l) {
     bufferReader_moveNext(l->bufferReader);
+    bufferReader_moveUntilChars(l->bufferReader, '\"', '\n');
 
-    while (!bufferReader_isEOF(l->bufferReader)) {
-        const char current = bufferReader_getCurrent(l->bufferReader);
-
-        if (current == '\n')
-            LX_throwError(l, "Multi-line strings are not allowed\n");
-        else if (current == '\"')
-            break;
-
-        bufferReader_moveNext(l->bufferReader);
-    }
+    if (bufferReader_getCurrent(l->bufferReader) == '\n')
+        LX_throwError(l, "Multi-line strings are not allowed\n");
 
     bufferReader_moveNext(l->bufferReader);
     FileLocation location = bufferReader_getLocation(l->bufferReader);
-    char *str = bufferReader_getSelected(l->bufferReader);
+    BufferSlice slice = bufferReader_getSelectedSlice(l->bufferReader);
 
     Token t = {
         .type = V_STRING,
-        .attribute.INT_ATTR = symbolsTable_getIdOrAddSymbol(l->symbolsTable, str),
+        .attribute.INT_ATTR = symbolsTable_getIdOrAddSymbolWithLength(l->symbolsTable, slice.str, slice.len),
         .location = location,
     };
 
-    free(str);
-
     return t;
 }
 
@@ -323,9 +451,7 @@ Token LX_getAsteriskToken(Lexer *l) {
 
 Token LX_getLineComment(Lexer *l) {
     bufferReader_moveNext(l->bufferReader);
-
-    while (!bufferReader_isEOF(l->bufferReader) && bufferReader_getCurrent(l->bufferReader) != '\n')
-        bufferReader_moveNext(l->bufferReader);
+    bufferReader_moveUntilChar(l->bufferReader, '\n');
 
     FileLocation location = bufferReader_getLocation(l->bufferReader);
 
@@ -346,17 +472,17 @@ Token LX_getBlockComment(Lexer *l) {
 
     while (!bufferReader_isEOF(l->bufferReader)) {
         bufferReader_moveNext(l->bufferReader);
+        bufferReader_moveUntilChar(l->bufferReader, '*');
 
-        const char current = bufferReader_getCurrent(l->bufferReader);
+        if (bufferReader_isEOF(l->bufferReader))
+            break;
 
-        if (current == '*') {
-            bufferReader_moveNext(l->bufferReader);
-            const char next = bufferReader_getCurrent(l->bufferReader);
+        bufferReader_moveNext(l->bufferReader);
+        const char next = bufferReader_getCurrent(l->bufferReader);
 
-            if (bufferReader_isEOF(l->bufferReader) || next == '/') {
-                bufferReader_moveNext(l->bufferReader);
-                break;
-            }
+        if (bufferReader_isEOF(l->bufferReader) || next == '/') {
+            bufferReader_moveNext(l->bufferReader);
+            break;
         }
     }
 
@@ -503,102 +629,445 @@ Token LX_getLessToken(Lexer *l) {
 
 #pragma endregion
 
+#pragma region SPACES
+
+void LX_skipSpaces(Lexer *l) {
+    bufferReader_moveWhileSpace(l->bufferReader);
+    bufferReader_ignoreSelected(l->bufferReader);
+}
+
+#pragma endregion
+
+#pragma region EOF
+
+Token LX_getEOFToken(Lexer *l) {
+    bufferReader_ignoreSelected(l->bufferReader);
+
+    Token t = {
+        .type = E_EOF,
+        .attribute.INT_ATTR = 0,
+        .location = bufferReader_getLocation(l->bufferReader),
+    };
+
+    return t;
+}
+
+#pragma endregion
+
 #pragma region TAD METHODS
 
-Lexer* lexer_init(const char* sourceFilePath, size_t bufferSize, SymbolsTable* symbolsTable) {
+Lexer* LX_init(BufferReader* bufferReader, SymbolsTable* symbolsTable) {
     Lexer* l = (Lexer*) malloc(sizeof(Lexer));
 
     if (l != NULL) {
-        l->bufferReader = bufferReader_init(sourceFilePath, bufferSize);
+        l->bufferReader = bufferReader;
         l->symbolsTable = symbolsTable;
+        l->errorHandler = NULL;
     }
 
     return l;
 }
 
-Token lexer_getNextToken(Lexer *l) {
-    Token t;
-    bool tokenFound;
-    
-    do {
-        tokenFound = true;
-        char current = bufferReader_getCurrent(l->bufferReader);
-
-        switch (current) {
-            case '\"':
-                t = LX_getString(l);
-                break;
-                
-            case '+':
-                t = LX_getPlusToken(l);
-                break;
-                
-            case '-':
-                t = LX_getMinusToken(l);
-                break;
-                
-            case '*':
-                t = LX_getAsteriskToken(l);
-                break;
-                
-            case '/':
-                t = LX_getSlashToken(l);
-                break;
-
-            case '%':
-                t = LX_getPercentageToken(l);
-                break;
-                
-            case '=':
-                t = LX_getEqualToken(l);
-                break;
-                
-            case '>':
-                t = LX_getGreaterToken(l);
-                break;
-                
-            case '<':
-                t = LX_getLessToken(l);
-                break;
-                
-            default:
-                if (isdigit(current))
-                    t = LX_getNumber(l);
-                else if (isalpha(current))
-                    t = LX_getName(l);
-                else if (ispunct(current))
-                    t = LX_getSymbol(l);
-                else {
-                    bufferReader_moveNext(l->bufferReader);
-                    bufferReader_ignoreSelected(l->bufferReader);
-    
-                    tokenFound = false;
-                }
-                break;
-                
-        }
-    } while (!tokenFound);
-    
+bool LX_isRegularFile(const char* sourceFilePath) {
+    struct stat sourceStat;
 
-    return t;
+    return stat(sourceFilePath, &sourceStat) == 0 && S_ISREG(sourceStat.st_mode);
 }
 
-bool lexer_hasNext(Lexer *l) {
-    char current = bufferReader_getCurrent(l->bufferReader);
+Lexer* lexer_init(const char* sourceFilePath, size_t bufferSize, SymbolsTable* symbolsTable) {
+    //Regular files are mapped in memory, pipes and others use the double buffer
+    if (LX_isRegularFile(sourceFilePath))
+        return LX_init(bufferReader_initMapped(sourceFilePath), symbolsTable);
+    else
+        return LX_init(bufferReader_init(sourceFilePath, bufferSize), symbolsTable);
+}
 
-    while (!bufferReader_isEOF(l->bufferReader) && isspace(current)) {
-        bufferReader_moveNext(l->bufferReader);
-        current = bufferReader_getCurrent(l->bufferReader);
+Lexer* lexer_initFromMemory(const char* source, size_t sourceSize, SymbolsTable* symbolsTable) {
+    return LX_init(bufferReader_initFromMemory(source, sourceSize), symbolsTable);
+}
+
+/*
+    The start state jumps straight to the state of the class of the current char,
+    with computed goto when the compiler supports it and with a switch otherwise
+*/
+#ifdef __GNUC__
+#define LX_START_STATE_DISPATCH(charClass) goto *LX_startStates[charClass];
+#define LX_START_STATE(charClass) LX_START_STATE_##charClass:
+#else
+#define LX_START_STATE_DISPATCH(charClass) switch (charClass)
+#define LX_START_STATE(charClass) case charClass:
+#endif
+
+Token lexer_getNextToken(Lexer *l) {
+#ifdef __GNUC__
+    static const void* const LX_startStates[] = {
+        [LX_CHAR_OTHER] = &&LX_START_STATE_LX_CHAR_OTHER,
+        [LX_CHAR_SPACE] = &&LX_START_STATE_LX_CHAR_SPACE,
+        [LX_CHAR_DIGIT] = &&LX_START_STATE_LX_CHAR_DIGIT,
+        [LX_CHAR_LETTER] = &&LX_START_STATE_LX_CHAR_LETTER,
+        [LX_CHAR_UNDERSCORE] = &&LX_START_STATE_LX_CHAR_UNDERSCORE,
+        [LX_CHAR_SYMBOL] = &&LX_START_STATE_LX_CHAR_SYMBOL,
+        [LX_CHAR_QUOTE] = &&LX_START_STATE_LX_CHAR_QUOTE,
+        [LX_CHAR_PLUS] = &&LX_START_STATE_LX_CHAR_PLUS,
+        [LX_CHAR_MINUS] = &&LX_START_STATE_LX_CHAR_MINUS,
+        [LX_CHAR_ASTERISK] = &&LX_START_STATE_LX_CHAR_ASTERISK,
+        [LX_CHAR_SLASH] = &&LX_START_STATE_LX_CHAR_SLASH,
+        [LX_CHAR_PERCENTAGE] = &&LX_START_STATE_LX_CHAR_PERCENTAGE,
+        [LX_CHAR_EQUAL] = &&LX_START_STATE_LX_CHAR_EQUAL,
+        [LX_CHAR_GREATER] = &&LX_START_STATE_LX_CHAR_GREATER,
+        [LX_CHAR_LESS] = &&LX_START_STATE_LX_CHAR_LESS,
+    };
+#endif
+
+    while (true) {
+        LX_skipSpaces(l);
+
+        if (bufferReader_isEOF(l->bufferReader))
+            return LX_getEOFToken(l);
+
+        const char current = bufferReader_getCurrent(l->bufferReader);
+
+        LX_START_STATE_DISPATCH(LX_getCharClass(current)) {
+            LX_START_STATE(LX_CHAR_QUOTE)
+                return LX_getString(l);
+
+            LX_START_STATE(LX_CHAR_PLUS)
+                return LX_getPlusToken(l);
+
+            LX_START_STATE(LX_CHAR_MINUS)
+                return LX_getMinusToken(l);
+
+            LX_START_STATE(LX_CHAR_ASTERISK)
+                return LX_getAsteriskToken(l);
+
+            LX_START_STATE(LX_CHAR_SLASH)
+                return LX_getSlashToken(l);
+
+            LX_START_STATE(LX_CHAR_PERCENTAGE)
+                return LX_getPercentageToken(l);
+
+            LX_START_STATE(LX_CHAR_EQUAL)
+                return LX_getEqualToken(l);
+
+            LX_START_STATE(LX_CHAR_GREATER)
+                return LX_getGreaterToken(l);
+
+            LX_START_STATE(LX_CHAR_LESS)
+                return LX_getLessToken(l);
+
+            LX_START_STATE(LX_CHAR_DIGIT)
+                return LX_getNumber(l);
+
+            LX_START_STATE(LX_CHAR_LETTER)
+                return LX_getName(l);
+
+            //A name can not start with '_', the symbol state reports it as invalid
+            LX_START_STATE(LX_CHAR_UNDERSCORE)
+            LX_START_STATE(LX_CHAR_SYMBOL)
+                return LX_getSymbol(l);
+
+            //Unknown chars are ignored
+            LX_START_STATE(LX_CHAR_SPACE)
+            LX_START_STATE(LX_CHAR_OTHER)
+                bufferReader_moveNext(l->bufferReader);
+                bufferReader_ignoreSelected(l->bufferReader);
+        }
     }
+}
 
-    bufferReader_ignoreSelected(l->bufferReader);
+bool lexer_hasNext(Lexer *l) {
+    LX_skipSpaces(l);
 
     return !bufferReader_isEOF(l->bufferReader);
 }
 
+size_t lexer_fillTokens(Lexer *l, Token *out, size_t cap) {
+    size_t tokensCount = 0;
+
+    while (tokensCount < cap) {
+        Token t = lexer_getNextToken(l);
+
+        if (t.type == E_EOF)
+            break;
+
+        out[tokensCount] = t;
+        tokensCount++;
+    }
+
+    return tokensCount;
+}
+
 void lexer_free(Lexer* l) {
     bufferReader_free(l->bufferReader);
     free(l);
 }
 
+void lexer_setErrorHandler(Lexer* l, jmp_buf* errorHandler) {
+    l->errorHandler = errorHandler;
+}
+
+FilePosition lexer_getErrorPosition(Lexer* l) {
+    return l->errorPosition;
+}
+
+#pragma endregion
+
+#pragma region PARALLEL
+
+#define LX_PARALLEL_MIN_CHUNK_SIZE 65536
+#define LX_PARALLEL_BUFFER_SIZE 1024
+
+struct LX_chunk {
+    const char* start;
+    size_t size;
+    size_t offset;
+    size_t linesCount;
+    TokenStream* tokenStream;
+    SymbolsTable* symbolsTable;
+    bool failed;
+    pthread_t thread;
+};
+
+const char* LX_min(const char* a, const char* b) {
+    return a < b ? a : b;
+}
+
+/*
+    Skips the string or comment (or the divide operator) at current, with the same rules
+    the lexer uses, and returns where the lexer is back in the start state.
+    A block comment never checks the char right after its start nor the char after a '*' that
+    is not followed by '/', so neither does this.
+*/
+const char* LX_skipStringOrComment(const char* current, const char* end) {
+    const char* found;
+
+    if (*current == '\"') {
+        found = charScanner_findChars(current + 1, end, '\"', '\n');
+
+        return found < end && *found != 0 ? found + 1 : found;
+    }
+
+    if (current + 1 >= end)
+        return end;
+
+    if (current[1] == '/') {
+        found = charScanner_findChar(current + 2, end, '\n');
+
+        return found < end && *found != 0 ? found + 1 : found;
+    }
+
+    if (current[1] != '*')
+        return current + 1;
+
+    if (current + 2 >= end || current[2] == 0)
+        return LX_min(current + 2, end);
+
+    current += 3;
+
+    while (current < end) {
+        found = charScanner_findChar(current, end, '*');
+
+        if (found == end || *found == 0)
+            return found;
+
+        if (found + 1 == end || found[1] == 0)
+            return found + 1;
+
+        if (found[1] == '/')
+            return found + 2;
+
+        current = found + 2;
+    }
+
+    return end;
+}
+
+/*
+    Pre-scan that splits the source in up to maxChunks chunks of similar size, each one
+    starting after a new line that is in the start state of the lexer (out of strings
+    and comments), so lexing the chunks on their own gives the same Tokens.
+    It gives up at a 0, the lexer reads it as EOF but may keep going after it, so the
+    last chunk always goes until the end of the source.
+*/
+size_t LX_splitInChunks(BufferSlice source, struct LX_chunk* chunks, size_t maxChunks) {
+    const char* end = source.str + source.len;
+    const char* current = source.str;
+    size_t chunksCount = 1;
+
+    chunks[0].start = source.str;
+
+    while (current < end && chunksCount < maxChunks) {
+        const char* target = source.str + source.len / maxChunks * chunksCount;
+        const char* next = charScanner_findChars(current, end, '\"', '/');
+
+        if (next > target) {
+            const char* newLine = charScanner_findChar(current > target ? current : target, next, '\n');
+
+            if (newLine < next && newLine + 1 < end) {
+                current = newLine + 1;
+                chunks[chunksCount].start = current;
+                chunksCount++;
+
+                continue;
+            }
+        }
+
+        if (next == end || *next == 0)
+            break;
+
+        current = LX_skipStringOrComment(next, end);
+    }
+
+    for (size_t i = 0; i < chunksCount; i++) {
+        const char* chunkEnd = i + 1 < chunksCount ? chunks[i + 1].start : end;
+
+        chunks[i].offset = chunks[i].start - source.str;
+        chunks[i].size = chunkEnd - chunks[i].start;
+    }
+
+    return chunksCount;
+}
+
+void* LX_lexChunk(void* arg) {
+    struct LX_chunk* chunk = (struct LX_chunk*) arg;
+    jmp_buf errorHandler;
+
+    chunk->tokenStream = tokenStream_init();
+    chunk->symbolsTable = symbolsTable_init();
+    chunk->failed = false;
+
+    Lexer* l = LX_init(bufferReader_initFromMemory(chunk->start, chunk->size), chunk->symbolsTable);
+    l->errorHandler = &errorHandler;
+
+    //An error stops the chunk, the whole source is lexed again to report it as usual
+    if (setjmp(errorHandler) == 0) {
+        Token t;
+
+        while ((t = lexer_getNextToken(l)).type != E_EOF)
+            tokenStream_append(chunk->tokenStream, t);
+
+        chunk->linesCount = bufferReader_getPosition(l->bufferReader, chunk->size).line - 1;
+    }
+    else
+        chunk->failed = true;
+
+    lexer_free(l);
+
+    return NULL;
+}
+
+void LX_remapChunkIds(struct LX_chunk* chunk, SymbolsTable* symbolsTable) {
+    const size_t symbolsCount = symbolsTable_getSize(chunk->symbolsTable);
+    size_t* globalIds = malloc(sizeof(size_t) * (symbolsCount + 1));
+
+    if (globalIds == NULL) {
+        fprintf(stderr, "Lexer Error: Unable to allocate %lu bytes\n", sizeof(size_t) * (symbolsCount + 1));
+        exit(1);
+    }
+
+    //Local ids follow the first use in the chunk, so adding them in order gives the sequential ids
+    for (size_t id = 1; id <= symbolsCount; id++) {
+        globalIds[id] = symbolsTable_getIdOrAddSymbolWithLength(symbolsTable,
+            symbolsTable_getName(chunk->symbolsTable, id), symbolsTable_getNameLength(chunk->symbolsTable, id));
+    }
+
+    for (size_t i = 0; i < tokenStream_getSize(chunk->tokenStream); i++) {
+        const enum tokenType type = tokenStream_getType(chunk->tokenStream, i);
+
+        if (type == I_ID || type == V_STRING) {
+            TokenAttribute attribute = tokenStream_getAttribute(chunk->tokenStream, i);
+            attribute.INT_ATTR = globalIds[attribute.INT_ATTR];
+
+            tokenStream_setAttribute(chunk->tokenStream, i, attribute);
+        }
+    }
+
+    free(globalIds);
+}
+
+TokenStream* LX_lexSequential(const char* sourceFilePath, SymbolsTable* symbolsTable) {
+    TokenStream* ts = tokenStream_init();
+    Lexer* l = lexer_init(sourceFilePath, LX_PARALLEL_BUFFER_SIZE, symbolsTable);
+    Token t;
+
+    while ((t = lexer_getNextToken(l)).type != E_EOF)
+        tokenStream_append(ts, t);
+
+    lexer_free(l);
+
+    return ts;
+}
+
+TokenStream* lexer_lexParallel(const char* sourceFilePath, size_t nThreads, SymbolsTable* symbolsTable) {
+    if (nThreads <= 1 || !LX_isRegularFile(sourceFilePath))
+        return LX_lexSequential(sourceFilePath, symbolsTable);
+
+    BufferReader* br = bufferReader_initMapped(sourceFilePath);
+    BufferSlice source = bufferReader_getSource(br);
+
+    size_t maxChunks = source.len / LX_PARALLEL_MIN_CHUNK_SIZE;
+    if (maxChunks > nThreads)
+        maxChunks = nThreads;
+
+    if (maxChunks <= 1) {
+        bufferReader_free(br);
+        return LX_lexSequential(sourceFilePath, symbolsTable);
+    }
+
+    struct LX_chunk* chunks = malloc(sizeof(struct LX_chunk) * maxChunks);
+
+    if (chunks == NULL) {
+        fprintf(stderr, "Lexer Error: Unable to allocate %lu bytes\n", sizeof(struct LX_chunk) * maxChunks);
+        exit(1);
+    }
+
+    const size_t chunksCount = LX_splitInChunks(source, chunks, maxChunks);
+    bool failed = false;
+
+    for (size_t i = 0; i < chunksCount; i++) {
+        if (pthread_create(&chunks[i].thread, NULL, LX_lexChunk, &chunks[i]) != 0) {
+            fprintf(stderr, "Lexer Error: Unable to create a thread\n");
+            exit(1);
+        }
+    }
+
+    for (size_t i = 0; i < chunksCount; i++) {
+        pthread_join(chunks[i].thread, NULL);
+        failed = failed || chunks[i].failed;
+    }
+
+    TokenStream* ts = NULL;
+
+    if (!failed) {
+        //The first chunk starts at offset 0 and line 1, so its stream is the result
+        ts = chunks[0].tokenStream;
+        LX_remapChunkIds(&chunks[0], symbolsTable);
+
+        size_t linesCount = chunks[0].linesCount;
+
+        //Merge in order, the remap needs all the previous chunks in the Symbols Table
+        for (size_t i = 1; i < chunksCount; i++) {
+            LX_remapChunkIds(&chunks[i], symbolsTable);
+            tokenStream_appendStream(ts, chunks[i].tokenStream, chunks[i].offset, linesCount);
+
+            linesCount += chunks[i].linesCount;
+        }
+    }
+
+    for (size_t i = 0; i < chunksCount; i++) {
+        if (chunks[i].tokenStream != ts)
+            tokenStream_free(chunks[i].tokenStream);
+
+        symbolsTable_free(chunks[i].symbolsTable);
+    }
+
+    free(chunks);
+    bufferReader_free(br);
+
+    if (failed)
+        return LX_lexSequential(sourceFilePath, symbolsTable);
+
+    return ts;
+}
+
 #pragma endregion
\ No newline at end of file
@@ -5,6 +5,7 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <setjmp.h>
 
 #include "bufferReader/bufferReader.h"
 
@@ -17,6 +18,7 @@ R: Reserved
 S: Symbol
 O: Operator
 C: Commentary
+E: End of file
 */
 enum tokenType {
     I_ID,
@@ -59,23 +61,40 @@ enum tokenType {
     O_DECREMENT,
     C_LINE_COMMENT,
     C_BLOCK_COMMENT,
+    E_EOF,
 };
 
+typedef union {
+    int INT_ATTR;
+    double FLOAT_ATTR;  
+} TokenAttribute;
+
 typedef struct {
     enum tokenType type;
     FileLocation location;
-    union {
-        int INT_ATTR;
-        double FLOAT_ATTR;  
-    } attribute;
-    
+    TokenAttribute attribute;
 } Token;
 
 
 Lexer* lexer_init(const char* sourceFilePath, size_t bufferSize, SymbolsTable* symbolsTable);
+//Lexes the source in place, it must outlive the Lexer
+Lexer* lexer_initFromMemory(const char* source, size_t sourceSize, SymbolsTable* symbolsTable);
 void lexer_free(Lexer* l);
 
+//Without a handler an error ends the program, with it the error jumps (longjmp) there and the Lexer can only be freed
+void lexer_setErrorHandler(Lexer* l, jmp_buf* errorHandler);
+//Where the error that jumped to the handler is
+FilePosition lexer_getErrorPosition(Lexer* l);
+
 Token lexer_getNextToken(Lexer *l);
 bool lexer_hasNext(Lexer *l);
+size_t lexer_fillTokens(Lexer *l, Token *out, size_t cap);
+
+/*
+    Lexes a regular file splitting it in chunks, one per thread, the result is the same
+    of the lexer_getNextToken loop (also the ids in the Symbols Table).
+    Free the returned stream with tokenStream_free (lexer/tokenStream/tokenStream.h).
+*/
+struct tokenStream* lexer_lexParallel(const char* sourceFilePath, size_t nThreads, SymbolsTable* symbolsTable);
 
 #endif
\ No newline at end of file
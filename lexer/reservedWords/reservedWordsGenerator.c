@@ -0,0 +1,95 @@
+#include "../../symbolsTable/symbolsTable.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/*
+    Build time generator of the reserved words lookup table.
+
+    It searches a multiplier and a table size where every reserved word lands in
+    its own slot with:
+        slot = (hash * seed) >> (32 - bits)
+    where hash is the same symbols table hash that the lexer computes while
+    reading a name, so finding out if a name is a reserved word is one multiply,
+    one shift and one compare.
+*/
+
+#define RWG_MAX_BITS 10
+#define RWG_MAX_SEED_TRIES 1000000
+
+const struct RWG_s_reservedWord {
+    const char* str;
+    const char* type;
+} RWG_reservedWords[] = {
+#define RESERVED_WORD(str, type) {str, #type},
+#include "reservedWords.def"
+#undef RESERVED_WORD
+};
+
+const size_t RWG_sizeReservedWords =
+    sizeof(RWG_reservedWords) / sizeof(struct RWG_s_reservedWord);
+
+uint32_t RWG_hash(const char* str) {
+    uint64_t hash = SYMBOLS_TABLE_HASH_INIT;
+
+    for (size_t i = 0; str[i] != 0; i++)
+        hash = symbolsTable_hashStep(hash, str[i]);
+
+    return symbolsTable_hashFinish(hash);
+}
+
+uint32_t RWG_getSlot(uint32_t hash, uint32_t seed, int bits) {
+    return (uint32_t) (hash * seed) >> (32 - bits);
+}
+
+bool RWG_isPerfect(uint32_t seed, int bits, int* slots) {
+    bool used[1 << RWG_MAX_BITS] = {false};
+
+    for (size_t i = 0; i < RWG_sizeReservedWords; i++) {
+        const uint32_t slot = RWG_getSlot(RWG_hash(RWG_reservedWords[i].str), seed, bits);
+
+        if (used[slot])
+            return false;
+
+        used[slot] = true;
+        slots[i] = slot;
+    }
+
+    return true;
+}
+
+int main() {
+    int slots[sizeof(RWG_reservedWords) / sizeof(struct RWG_s_reservedWord)];
+
+    int bits = 1;
+    while ((1u << bits) < RWG_sizeReservedWords)
+        bits++;
+
+    for (; bits <= RWG_MAX_BITS; bits++) {
+        for (uint32_t seed = 1; seed < RWG_MAX_SEED_TRIES * 2; seed += 2) {
+            if (!RWG_isPerfect(seed, bits, slots))
+                continue;
+
+            printf("// Generated by reservedWordsGenerator.c from reservedWords.def, do not edit\n\n");
+            printf("#define LX_RESERVED_WORDS_SEED %uu\n", seed);
+            printf("#define LX_RESERVED_WORDS_BITS %d\n\n", bits);
+            printf("#define LX_RESERVED_WORDS_TABLE \\\n");
+
+            for (size_t i = 0; i < RWG_sizeReservedWords; i++) {
+                printf("    [%d] = {.str = \"%s\", .len = %lu, .type = %s}, \\\n",
+                    slots[i], RWG_reservedWords[i].str,
+                    strlen(RWG_reservedWords[i].str), RWG_reservedWords[i].type);
+            }
+
+            printf("\n");
+
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "Reserved Words Generator Error: Unable to find a perfect hash\n");
+    return 1;
+}
@@ -0,0 +1,362 @@
+#include "tokenSerializer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef struct {
+    const char* name;
+    size_t len;
+} TSZ_TypeName;
+
+#define TSZ_TYPE_NAME(type) [type] = { #type, sizeof(#type) - 1 }
+
+static const TSZ_TypeName TSZ_typeNames[] = {
+    TSZ_TYPE_NAME(I_ID),
+    TSZ_TYPE_NAME(V_NUM_INT),
+    TSZ_TYPE_NAME(V_NUM_FLOAT),
+    TSZ_TYPE_NAME(V_STRING),
+    TSZ_TYPE_NAME(R_VOID),
+    TSZ_TYPE_NAME(R_MAIN),
+    TSZ_TYPE_NAME(R_IF),
+    TSZ_TYPE_NAME(R_ELSE),
+    TSZ_TYPE_NAME(R_FOR),
+    TSZ_TYPE_NAME(R_WHILE),
+    TSZ_TYPE_NAME(R_INT),
+    TSZ_TYPE_NAME(R_FLOAT),
+    TSZ_TYPE_NAME(R_CHAR),
+    TSZ_TYPE_NAME(R_SCANF),
+    TSZ_TYPE_NAME(R_PRINT),
+    TSZ_TYPE_NAME(R_RETURN),
+    TSZ_TYPE_NAME(S_OPEN_PARENTHESIS),
+    TSZ_TYPE_NAME(S_CLOSE_PARENTHESIS),
+    TSZ_TYPE_NAME(S_OPEN_SQUARE_BRACKETS),
+    TSZ_TYPE_NAME(S_CLOSE_SQUARE_BRACKETS),
+    TSZ_TYPE_NAME(S_OPEN_CURLY_BRACKETS),
+    TSZ_TYPE_NAME(S_CLOSE_CURLY_BRACKETS),
+    TSZ_TYPE_NAME(S_ATTRIBUTION),
+    TSZ_TYPE_NAME(S_COMMA),
+    TSZ_TYPE_NAME(S_SEMICOLON),
+    TSZ_TYPE_NAME(S_DOT),
+    TSZ_TYPE_NAME(O_EQUAL),
+    TSZ_TYPE_NAME(O_ADD),
+    TSZ_TYPE_NAME(O_SUBTRACT),
+    TSZ_TYPE_NAME(O_MULTIPLY),
+    TSZ_TYPE_NAME(O_DIVIDE),
+    TSZ_TYPE_NAME(O_MOD),
+    TSZ_TYPE_NAME(O_LESS),
+    TSZ_TYPE_NAME(O_LESS_EQUAL),
+    TSZ_TYPE_NAME(O_GREATER),
+    TSZ_TYPE_NAME(O_GREATER_EQUAL),
+    TSZ_TYPE_NAME(O_INCREMENT),
+    TSZ_TYPE_NAME(O_DECREMENT),
+    TSZ_TYPE_NAME(C_LINE_COMMENT),
+    TSZ_TYPE_NAME(C_BLOCK_COMMENT),
+    TSZ_TYPE_NAME(E_EOF),
+};
+
+#pragma region JSON
+
+//Two digits at a time, "00" to "99"
+static const char TSZ_digitPairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+#define TSZ_WRITE_LITERAL(out, literal) (memcpy((out), (literal), sizeof(literal) - 1), sizeof(literal) - 1)
+
+size_t TSZ_writeUnsigned(uint64_t value, char* out) {
+    char digits[20];
+    char* start = digits + sizeof(digits);
+
+    while (value >= 100) {
+        const size_t pair = (value % 100) * 2;
+        value /= 100;
+
+        start -= 2;
+        start[0] = TSZ_digitPairs[pair];
+        start[1] = TSZ_digitPairs[pair + 1];
+    }
+
+    if (value >= 10) {
+        start -= 2;
+        start[0] = TSZ_digitPairs[value * 2];
+        start[1] = TSZ_digitPairs[value * 2 + 1];
+    }
+    else {
+        *--start = '0' + value;
+    }
+
+    const size_t len = digits + sizeof(digits) - start;
+    memcpy(out, start, len);
+
+    return len;
+}
+
+size_t TSZ_writeSigned(int64_t value, char* out) {
+    if (value >= 0)
+        return TSZ_writeUnsigned(value, out);
+
+    out[0] = '-';
+
+    return TSZ_writeUnsigned(-(uint64_t) value, out + 1) + 1;
+}
+
+//Writes value / 10^decimals with the dot in place
+size_t TSZ_writeDecimal(int64_t value, size_t decimals, char* out) {
+    char* p = out;
+
+    if (value < 0) {
+        *p++ = '-';
+        value = -value;
+    }
+
+    char digits[20];
+    const size_t digitsLen = TSZ_writeUnsigned(value, digits);
+
+    if (digitsLen > decimals) {
+        const size_t integerLen = digitsLen - decimals;
+
+        memcpy(p, digits, integerLen);
+        p += integerLen;
+        *p++ = '.';
+        memcpy(p, digits + integerLen, decimals);
+        p += decimals;
+    }
+    else {
+        *p++ = '0';
+        *p++ = '.';
+
+        for (size_t i = digitsLen; i < decimals; i++)
+            *p++ = '0';
+
+        memcpy(p, digits, digitsLen);
+        p += digitsLen;
+    }
+
+    return p - out;
+}
+
+/*
+    Shortest text that reads back as the same double: integers are written as
+    integers, numbers with up to 9 decimals (all the usual literals) are found
+    scaling by powers of 10, and the others try each precision of %g until
+    strtod gives the value back (17 digits always do).
+*/
+size_t TSZ_writeDouble(double value, char* out) {
+    //NaN and infinity have no JSON number
+    if (value != value || value - value != 0)
+        return TSZ_WRITE_LITERAL(out, "null");
+
+    if (value > -1e15 && value < 1e15 && value == (double) (int64_t) value)
+        return TSZ_writeSigned((int64_t) value, out);
+
+    double scale = 1;
+
+    for (size_t decimals = 1; decimals <= 9; decimals++) {
+        scale *= 10;
+        const double scaled = value * scale;
+
+        if (scaled <= -1e15 || scaled >= 1e15)
+            break;
+
+        //Dividing is correctly rounded, so it only gives value back if these digits read as it
+        const int64_t digits = (int64_t) (scaled + (scaled >= 0 ? 0.5 : -0.5));
+
+        if ((double) digits / scale == value)
+            return TSZ_writeDecimal(digits, decimals, out);
+    }
+
+    size_t len = 0;
+
+    for (int precision = 1; precision <= 17; precision++) {
+        len = sprintf(out, "%.*g", precision, value);
+
+        if (strtod(out, NULL) == value)
+            break;
+    }
+
+    return len;
+}
+
+const char* tokenSerializer_getTypeName(enum tokenType type, size_t* nameLen) {
+    const TSZ_TypeName typeName = TSZ_typeNames[type];
+
+    if (nameLen != NULL)
+        *nameLen = typeName.len;
+
+    return typeName.name;
+}
+
+size_t tokenSerializer_writeJson(const Token* t, char* out) {
+    char* p = out;
+    size_t nameLen;
+    const char* name = tokenSerializer_getTypeName(t->type, &nameLen);
+
+    p += TSZ_WRITE_LITERAL(p, "{\"type\": \"");
+    memcpy(p, name, nameLen);
+    p += nameLen;
+
+    p += TSZ_WRITE_LITERAL(p, "\",\"location\": {\"start\": {\"line\": ");
+    p += TSZ_writeUnsigned(t->location.start.line, p);
+    p += TSZ_WRITE_LITERAL(p, ",\"column\": ");
+    p += TSZ_writeUnsigned(t->location.start.column, p);
+
+    p += TSZ_WRITE_LITERAL(p, "},\"end\": {\"line\": ");
+    p += TSZ_writeUnsigned(t->location.end.line, p);
+    p += TSZ_WRITE_LITERAL(p, ",\"column\": ");
+    p += TSZ_writeUnsigned(t->location.end.column, p);
+
+    p += TSZ_WRITE_LITERAL(p, "}},\"attr\": ");
+
+    if (t->type == V_NUM_FLOAT)
+        p += TSZ_writeDouble(t->attribute.FLOAT_ATTR, p);
+    else
+        p += TSZ_writeSigned(t->attribute.INT_ATTR, p);
+
+    *p++ = '}';
+
+    return p - out;
+}
+
+#pragma endregion
+
+#pragma region BINARY
+
+void TSZ_putU16(char* out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+void TSZ_putU32(char* out, uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        out[i] = (value >> (i * 8)) & 0xFF;
+}
+
+void TSZ_putU64(char* out, uint64_t value) {
+    for (int i = 0; i < 8; i++)
+        out[i] = (value >> (i * 8)) & 0xFF;
+}
+
+uint16_t TSZ_getU16(const char* in) {
+    const unsigned char* bytes = (const unsigned char*) in;
+
+    return bytes[0] | (bytes[1] << 8);
+}
+
+uint32_t TSZ_getU32(const char* in) {
+    const unsigned char* bytes = (const unsigned char*) in;
+    uint32_t value = 0;
+
+    for (int i = 3; i >= 0; i--)
+        value = (value << 8) | bytes[i];
+
+    return value;
+}
+
+uint64_t TSZ_getU64(const char* in) {
+    const unsigned char* bytes = (const unsigned char*) in;
+    uint64_t value = 0;
+
+    for (int i = 7; i >= 0; i--)
+        value = (value << 8) | bytes[i];
+
+    return value;
+}
+
+uint32_t TSZ_toUint32OrExitWithError(size_t value) {
+    if (value > UINT32_MAX) {
+        fprintf(stderr, "Token Serializer Error: %lu doesn't fit in the binary format\n", value);
+        exit(1);
+    }
+
+    return (uint32_t) value;
+}
+
+size_t tokenSerializer_writeBinaryHeader(uint32_t symbolsCount, uint32_t tokensCount, char* out) {
+    memcpy(out, TOKEN_SERIALIZER_BINARY_MAGIC, 4);
+    TSZ_putU16(out + 4, TOKEN_SERIALIZER_BINARY_VERSION);
+    TSZ_putU16(out + 6, TOKEN_SERIALIZER_BINARY_RECORD_SIZE);
+    TSZ_putU32(out + 8, symbolsCount);
+    TSZ_putU32(out + 12, tokensCount);
+
+    return TOKEN_SERIALIZER_BINARY_HEADER_SIZE;
+}
+
+size_t tokenSerializer_writeBinarySymbol(const char* name, uint32_t nameLen, char* out) {
+    TSZ_putU32(out, nameLen);
+    memcpy(out + TOKEN_SERIALIZER_BINARY_SYMBOL_LENGTH_SIZE, name, nameLen);
+
+    return TOKEN_SERIALIZER_BINARY_SYMBOL_LENGTH_SIZE + nameLen;
+}
+
+size_t tokenSerializer_writeBinaryToken(const Token* t, char* out) {
+    out[0] = (char) t->type;
+    out[1] = out[2] = out[3] = 0;
+
+    TSZ_putU32(out + 4, TSZ_toUint32OrExitWithError(t->location.start.line));
+    TSZ_putU32(out + 8, TSZ_toUint32OrExitWithError(t->location.start.column));
+    TSZ_putU32(out + 12, TSZ_toUint32OrExitWithError(t->location.end.line));
+    TSZ_putU32(out + 16, TSZ_toUint32OrExitWithError(t->location.end.column));
+
+    uint64_t attribute;
+
+    if (t->type == V_NUM_FLOAT)
+        memcpy(&attribute, &t->attribute.FLOAT_ATTR, sizeof(attribute));
+    else
+        attribute = (uint64_t) (int64_t) t->attribute.INT_ATTR;
+
+    TSZ_putU64(out + 20, attribute);
+
+    return TOKEN_SERIALIZER_BINARY_RECORD_SIZE;
+}
+
+bool tokenSerializer_readBinaryHeader(const char* in, TokenBinaryHeader* header) {
+    if (memcmp(in, TOKEN_SERIALIZER_BINARY_MAGIC, 4) != 0)
+        return false;
+
+    header->version = TSZ_getU16(in + 4);
+    header->recordSize = TSZ_getU16(in + 6);
+    header->symbolsCount = TSZ_getU32(in + 8);
+    header->tokensCount = TSZ_getU32(in + 12);
+
+    return true;
+}
+
+const char* tokenSerializer_readBinarySymbol(const char* in, uint32_t* nameLen) {
+    *nameLen = TSZ_getU32(in);
+
+    return in + TOKEN_SERIALIZER_BINARY_SYMBOL_LENGTH_SIZE;
+}
+
+Token tokenSerializer_readBinaryToken(const char* in) {
+    Token t;
+
+    t.type = (enum tokenType) (unsigned char) in[0];
+
+    t.location.start.line = TSZ_getU32(in + 4);
+    t.location.start.column = TSZ_getU32(in + 8);
+    t.location.start.offset = 0;
+    t.location.end.line = TSZ_getU32(in + 12);
+    t.location.end.column = TSZ_getU32(in + 16);
+    t.location.end.offset = 0;
+
+    const uint64_t attribute = TSZ_getU64(in + 20);
+
+    if (t.type == V_NUM_FLOAT)
+        memcpy(&t.attribute.FLOAT_ATTR, &attribute, sizeof(attribute));
+    else
+        t.attribute.INT_ATTR = (int) (int64_t) attribute;
+
+    return t;
+}
+
+#pragma endregion
\ No newline at end of file
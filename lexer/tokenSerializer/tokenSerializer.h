@@ -0,0 +1,52 @@
+#ifndef TOKEN_SERIALIZER_H
+#define TOKEN_SERIALIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../lexer.h"
+
+//Biggest JSON of one Token, the output of writeJson must have at least this size
+#define TOKEN_SERIALIZER_JSON_MAX_SIZE 256
+
+const char* tokenSerializer_getTypeName(enum tokenType type, size_t* nameLen);
+
+//Writes the Token as a JSON object (not NUL terminated), returns the bytes written
+size_t tokenSerializer_writeJson(const Token* t, char* out);
+
+/*
+    Binary format, all numbers in little endian:
+        - Header (16 bytes): "LXTK", version (u16), record size (u16),
+          symbols count (u32) and Tokens count (u32).
+        - Symbols: for each id of the Symbols Table, from 1, the name length
+          (u32) followed by the name.
+        - Tokens: one record (28 bytes) each: type (u8), 3 zero bytes, start
+          line, start column, end line and end column (u32 each) and the
+          attribute (8 bytes), a double for V_NUM_FLOAT or else an i64, that
+          is the symbol id of I_ID and V_STRING.
+*/
+#define TOKEN_SERIALIZER_BINARY_MAGIC "LXTK"
+#define TOKEN_SERIALIZER_BINARY_VERSION 1
+#define TOKEN_SERIALIZER_BINARY_HEADER_SIZE 16
+#define TOKEN_SERIALIZER_BINARY_SYMBOL_LENGTH_SIZE 4
+#define TOKEN_SERIALIZER_BINARY_RECORD_SIZE 28
+
+typedef struct {
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t symbolsCount;
+    uint32_t tokensCount;
+} TokenBinaryHeader;
+
+size_t tokenSerializer_writeBinaryHeader(uint32_t symbolsCount, uint32_t tokensCount, char* out);
+size_t tokenSerializer_writeBinarySymbol(const char* name, uint32_t nameLen, char* out);
+size_t tokenSerializer_writeBinaryToken(const Token* t, char* out);
+
+//Returns false when it doesn't start with the magic
+bool tokenSerializer_readBinaryHeader(const char* in, TokenBinaryHeader* header);
+//The name isn't NUL terminated, the next symbol starts after it
+const char* tokenSerializer_readBinarySymbol(const char* in, uint32_t* nameLen);
+Token tokenSerializer_readBinaryToken(const char* in);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,257 @@
+#include "tokenStream.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define TS_INITIAL_CAPACITY 1024
+
+struct tokenStream {
+    uint8_t* types;
+    uint32_t* offsets;
+    uint32_t* lengths;
+    TokenAttribute* attributes;
+    size_t size;
+    size_t capacity;
+
+    /*
+        Sparse line table, it only has the lines where some Token starts or ends,
+        that is enough to compute the position of any Token in the stream.
+    */
+    uint32_t* lineNumbers;
+    uint32_t* lineStarts;
+    size_t linesSize;
+    size_t linesCapacity;
+};
+
+void* TS_reallocOrExitWithError(void* ptr, size_t size) {
+    void* m = realloc(ptr, size);
+
+    if (m == NULL) {
+        fprintf(stderr, "Token Stream Error: Unable to allocate %lu bytes\n", size);
+        exit(1);
+    }
+
+    return m;
+}
+
+uint32_t TS_toUint32OrExitWithError(size_t value) {
+    if (value > UINT32_MAX) {
+        fprintf(stderr, "Token Stream Error: Offset %lu is too big to be stored\n", value);
+        exit(1);
+    }
+
+    return (uint32_t) value;
+}
+
+void TS_growTokens(TokenStream* ts) {
+    ts->capacity *= 2;
+
+    ts->types = TS_reallocOrExitWithError(ts->types, sizeof(uint8_t) * ts->capacity);
+    ts->offsets = TS_reallocOrExitWithError(ts->offsets, sizeof(uint32_t) * ts->capacity);
+    ts->lengths = TS_reallocOrExitWithError(ts->lengths, sizeof(uint32_t) * ts->capacity);
+    ts->attributes = TS_reallocOrExitWithError(ts->attributes, sizeof(TokenAttribute) * ts->capacity);
+}
+
+void TS_reserveTokens(TokenStream* ts, size_t count) {
+    while (ts->size + count > ts->capacity)
+        TS_growTokens(ts);
+}
+
+void TS_addLine(TokenStream* ts, size_t line, size_t lineStart) {
+    //Tokens are appended in order, so only a line after the last one is new
+    if (ts->linesSize > 0 && line <= ts->lineNumbers[ts->linesSize - 1])
+        return;
+
+    if (ts->linesSize == ts->linesCapacity) {
+        ts->linesCapacity *= 2;
+
+        ts->lineNumbers = TS_reallocOrExitWithError(ts->lineNumbers, sizeof(uint32_t) * ts->linesCapacity);
+        ts->lineStarts = TS_reallocOrExitWithError(ts->lineStarts, sizeof(uint32_t) * ts->linesCapacity);
+    }
+
+    ts->lineNumbers[ts->linesSize] = TS_toUint32OrExitWithError(line);
+    ts->lineStarts[ts->linesSize] = TS_toUint32OrExitWithError(lineStart);
+    ts->linesSize++;
+}
+
+void TS_recordLine(TokenStream* ts, FilePosition position) {
+    TS_addLine(ts, position.line, position.offset - (position.column - 1));
+}
+
+size_t TS_findLine(TokenStream* ts, uint32_t offset) {
+    size_t low = 0;
+    size_t high = ts->linesSize;
+
+    //Last line that starts at or before the offset
+    while (high - low > 1) {
+        const size_t middle = low + (high - low) / 2;
+
+        if (ts->lineStarts[middle] <= offset)
+            low = middle;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+FilePosition TS_getPositionInLine(TokenStream* ts, size_t lineIndex, uint32_t offset) {
+    FilePosition position = {
+        .line = ts->lineNumbers[lineIndex],
+        .column = offset - ts->lineStarts[lineIndex] + 1,
+        .offset = offset,
+    };
+
+    return position;
+}
+
+Token TS_getTokenInLines(TokenStream* ts, size_t index, size_t startLineIndex, size_t endLineIndex) {
+    const uint32_t startOffset = ts->offsets[index];
+    const uint32_t endOffset = startOffset + ts->lengths[index];
+
+    Token t = {
+        .type = ts->types[index],
+        .location.start = TS_getPositionInLine(ts, startLineIndex, startOffset),
+        .location.end = TS_getPositionInLine(ts, endLineIndex, endOffset),
+        .attribute = ts->attributes[index],
+    };
+
+    return t;
+}
+
+size_t TS_advanceLine(TokenStream* ts, size_t lineIndex, uint32_t offset) {
+    while (lineIndex + 1 < ts->linesSize && ts->lineStarts[lineIndex + 1] <= offset)
+        lineIndex++;
+
+    return lineIndex;
+}
+
+TokenStream* tokenStream_init() {
+    TokenStream* ts = (TokenStream*) malloc(sizeof(TokenStream));
+
+    if (ts != NULL) {
+        ts->size = 0;
+        ts->capacity = TS_INITIAL_CAPACITY;
+
+        ts->types = TS_reallocOrExitWithError(NULL, sizeof(uint8_t) * ts->capacity);
+        ts->offsets = TS_reallocOrExitWithError(NULL, sizeof(uint32_t) * ts->capacity);
+        ts->lengths = TS_reallocOrExitWithError(NULL, sizeof(uint32_t) * ts->capacity);
+        ts->attributes = TS_reallocOrExitWithError(NULL, sizeof(TokenAttribute) * ts->capacity);
+
+        ts->linesSize = 0;
+        ts->linesCapacity = TS_INITIAL_CAPACITY;
+
+        ts->lineNumbers = TS_reallocOrExitWithError(NULL, sizeof(uint32_t) * ts->linesCapacity);
+        ts->lineStarts = TS_reallocOrExitWithError(NULL, sizeof(uint32_t) * ts->linesCapacity);
+    }
+
+    return ts;
+}
+
+void tokenStream_free(TokenStream* ts) {
+    free(ts->types);
+    free(ts->offsets);
+    free(ts->lengths);
+    free(ts->attributes);
+    free(ts->lineNumbers);
+    free(ts->lineStarts);
+    free(ts);
+}
+
+void tokenStream_append(TokenStream* ts, Token t) {
+    if (ts->size == ts->capacity)
+        TS_growTokens(ts);
+
+    ts->types[ts->size] = t.type;
+    ts->offsets[ts->size] = TS_toUint32OrExitWithError(t.location.start.offset);
+    ts->lengths[ts->size] = TS_toUint32OrExitWithError(t.location.end.offset - t.location.start.offset);
+    ts->attributes[ts->size] = t.attribute;
+    ts->size++;
+
+    TS_recordLine(ts, t.location.start);
+    TS_recordLine(ts, t.location.end);
+}
+
+void tokenStream_appendStream(TokenStream* ts, TokenStream* other, size_t offsetShift, size_t lineShift) {
+    TS_reserveTokens(ts, other->size);
+
+    memcpy(ts->types + ts->size, other->types, sizeof(uint8_t) * other->size);
+    memcpy(ts->lengths + ts->size, other->lengths, sizeof(uint32_t) * other->size);
+    memcpy(ts->attributes + ts->size, other->attributes, sizeof(TokenAttribute) * other->size);
+
+    for (size_t i = 0; i < other->size; i++)
+        ts->offsets[ts->size + i] = TS_toUint32OrExitWithError(other->offsets[i] + offsetShift);
+
+    ts->size += other->size;
+
+    for (size_t i = 0; i < other->linesSize; i++)
+        TS_addLine(ts, other->lineNumbers[i] + lineShift, other->lineStarts[i] + offsetShift);
+}
+
+size_t tokenStream_getSize(TokenStream* ts) {
+    return ts->size;
+}
+
+Token tokenStream_getToken(TokenStream* ts, size_t index) {
+    const uint32_t startOffset = ts->offsets[index];
+    const uint32_t endOffset = startOffset + ts->lengths[index];
+
+    return TS_getTokenInLines(ts, index, TS_findLine(ts, startOffset), TS_findLine(ts, endOffset));
+}
+
+enum tokenType tokenStream_getType(TokenStream* ts, size_t index) {
+    return ts->types[index];
+}
+
+uint32_t tokenStream_getOffset(TokenStream* ts, size_t index) {
+    return ts->offsets[index];
+}
+
+uint32_t tokenStream_getLength(TokenStream* ts, size_t index) {
+    return ts->lengths[index];
+}
+
+TokenAttribute tokenStream_getAttribute(TokenStream* ts, size_t index) {
+    return ts->attributes[index];
+}
+
+void tokenStream_setAttribute(TokenStream* ts, size_t index, TokenAttribute attribute) {
+    ts->attributes[index] = attribute;
+}
+
+FilePosition tokenStream_getPosition(TokenStream* ts, uint32_t offset) {
+    return TS_getPositionInLine(ts, TS_findLine(ts, offset), offset);
+}
+
+TokenStreamIterator tokenStream_iterate(TokenStream* ts) {
+    TokenStreamIterator it = {
+        .tokenStream = ts,
+        .index = 0,
+        .lineIndex = 0,
+    };
+
+    return it;
+}
+
+bool tokenStream_next(TokenStreamIterator* it, Token* t) {
+    TokenStream* ts = it->tokenStream;
+
+    if (it->index >= ts->size)
+        return false;
+
+    //Offsets only grow along the stream, so the line is found walking forward
+    const uint32_t startOffset = ts->offsets[it->index];
+    const uint32_t endOffset = startOffset + ts->lengths[it->index];
+
+    const size_t startLineIndex = TS_advanceLine(ts, it->lineIndex, startOffset);
+    it->lineIndex = TS_advanceLine(ts, startLineIndex, endOffset);
+
+    *t = TS_getTokenInLines(ts, it->index, startLineIndex, it->lineIndex);
+    it->index++;
+
+    return true;
+}
\ No newline at end of file
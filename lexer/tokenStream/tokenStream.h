@@ -0,0 +1,48 @@
+#ifndef TOKEN_STREAM_H
+#define TOKEN_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../lexer.h"
+
+/*
+    Compact storage of Tokens in struct of arrays layout (17 bytes per Token
+    instead of a whole Token), only the byte offset and length are kept and the
+    line and column are computed on demand.
+*/
+typedef struct tokenStream TokenStream;
+
+typedef struct {
+    TokenStream* tokenStream;
+    size_t index;
+    size_t lineIndex;
+} TokenStreamIterator;
+
+TokenStream* tokenStream_init();
+void tokenStream_free(TokenStream* ts);
+
+void tokenStream_append(TokenStream* ts, Token t);
+//Appends all Tokens of other, moving them by offsetShift bytes and lineShift lines
+void tokenStream_appendStream(TokenStream* ts, TokenStream* other, size_t offsetShift, size_t lineShift);
+size_t tokenStream_getSize(TokenStream* ts);
+
+Token tokenStream_getToken(TokenStream* ts, size_t index);
+enum tokenType tokenStream_getType(TokenStream* ts, size_t index);
+uint32_t tokenStream_getOffset(TokenStream* ts, size_t index);
+uint32_t tokenStream_getLength(TokenStream* ts, size_t index);
+TokenAttribute tokenStream_getAttribute(TokenStream* ts, size_t index);
+void tokenStream_setAttribute(TokenStream* ts, size_t index, TokenAttribute attribute);
+/*
+    Only for the offsets where a Token of the stream starts or ends: the line
+    table only has the lines of the Tokens, so an offset in a line without a
+    Token start or end (a blank line, the middle of a multi-line comment) gets
+    the line before it that has one and a column counted from its start.
+*/
+FilePosition tokenStream_getPosition(TokenStream* ts, uint32_t offset);
+
+TokenStreamIterator tokenStream_iterate(TokenStream* ts);
+bool tokenStream_next(TokenStreamIterator* it, Token* t);
+
+#endif
\ No newline at end of file
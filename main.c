@@ -5,6 +5,7 @@
 #include "symbolsTable/symbolsTable.h"
 
 #define CODE_SOURCE_FILE "code_example.txt"
+#define TOKENS_BLOCK_SIZE 4096
 
 const char* getTokenTypeAsString(enum tokenType type) {
     switch (type) {
@@ -88,6 +89,8 @@ const char* getTokenTypeAsString(enum tokenType type) {
             return "C_LINE_COMMENT";
         case C_BLOCK_COMMENT:
             return "C_BLOCK_COMMENT";
+        case E_EOF:
+            return "E_EOF";
     }
 }
 
@@ -110,9 +113,12 @@ int main() {
 
     Lexer* l = lexer_init(CODE_SOURCE_FILE, 100, st);
 
-    while (lexer_hasNext(l)) {
-        Token t = lexer_getNextToken(l);
-        printToken(t);
+    Token tokens[TOKENS_BLOCK_SIZE];
+    size_t tokensCount;
+
+    while ((tokensCount = lexer_fillTokens(l, tokens, TOKENS_BLOCK_SIZE)) > 0) {
+        for (size_t i = 0; i < tokensCount; i++)
+            printToken(tokens[i]);
     }
 
     lexer_free(l);
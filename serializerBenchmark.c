@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lexer/lexer.h"
+#include "lexer/tokenSerializer/tokenSerializer.h"
+#include "symbolsTable/symbolsTable.h"
+
+#define CODE_SOURCE_FILE "code_example.txt"
+#define TOKENS_BLOCK_SIZE 4096
+#define MIN_BENCHMARK_TOKENS 10000000
+
+/*
+    Serializes the Tokens of a source to JSON many times with the sprintf
+    templates the server used before and with the tokenSerializer, and prints
+    how many Tokens per second each one does:
+        $ ./benchmark.out [source file]
+*/
+
+typedef size_t (*Serializer)(const Token* t, char* out);
+
+void* mallocOrExitWithError(size_t size) {
+    void* m = malloc(size);
+
+    if (m == NULL) {
+        fprintf(stderr, "Benchmark Error: Unable to allocate %lu bytes\n", size);
+        exit(1);
+    }
+
+    return m;
+}
+
+size_t sprintfSerializer(const Token* t, char* out) {
+    const char *tokenJsonTemplate = 
+        "{"
+            "\"type\": \"%s\","
+            "\"location\": {"
+                "\"start\": {"
+                    "\"line\": %lu,"
+                    "\"column\": %lu"    
+                "},"
+                "\"end\": {"
+                    "\"line\": %lu,"
+                    "\"column\": %lu"    
+                "}"
+            "},"
+            "\"attr\": %s"
+        "}";
+
+    char attrBuff[50];
+    if (t->type == V_NUM_FLOAT)
+        sprintf(attrBuff, "%f", t->attribute.FLOAT_ATTR);
+    else
+        sprintf(attrBuff, "%d", t->attribute.INT_ATTR);
+
+    return sprintf(out, tokenJsonTemplate, tokenSerializer_getTypeName(t->type, NULL), 
+        t->location.start.line, t->location.start.column, 
+        t->location.end.line, t->location.end.column,
+        attrBuff);
+}
+
+Token* lexAll(const char* path, size_t* tokensCount) {
+    SymbolsTable* st = symbolsTable_init();
+    Lexer* l = lexer_init(path, 4096, st);
+
+    size_t capacity = TOKENS_BLOCK_SIZE;
+    Token* tokens = mallocOrExitWithError(sizeof(Token) * capacity);
+    size_t lexed;
+
+    *tokensCount = 0;
+
+    while ((lexed = lexer_fillTokens(l, tokens + *tokensCount, TOKENS_BLOCK_SIZE)) > 0) {
+        *tokensCount += lexed;
+
+        if (capacity - *tokensCount < TOKENS_BLOCK_SIZE) {
+            capacity *= 2;
+            tokens = realloc(tokens, sizeof(Token) * capacity);
+
+            if (tokens == NULL) {
+                fprintf(stderr, "Benchmark Error: Unable to allocate %lu bytes\n", sizeof(Token) * capacity);
+                exit(1);
+            }
+        }
+    }
+
+    lexer_free(l);
+    symbolsTable_free(st);
+
+    return tokens;
+}
+
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+void benchmark(const char* name, Serializer serializer, Token* tokens, size_t tokensCount) {
+    //Written in blocks, like the chunks of the server, to measure the serializer and not the memory
+    char* out = mallocOrExitWithError(sizeof(char) * (TOKEN_SERIALIZER_JSON_MAX_SIZE + 1) * TOKENS_BLOCK_SIZE);
+
+    const size_t rounds = MIN_BENCHMARK_TOKENS / tokensCount + 1;
+    size_t bytes = 0;
+
+    const double start = now();
+
+    for (size_t round = 0; round < rounds; round++) {
+        for (size_t block = 0; block < tokensCount; block += TOKENS_BLOCK_SIZE) {
+            const size_t blockEnd = block + TOKENS_BLOCK_SIZE < tokensCount ? block + TOKENS_BLOCK_SIZE : tokensCount;
+            char* p = out;
+
+            for (size_t i = block; i < blockEnd; i++) {
+                p += serializer(&tokens[i], p);
+                *p++ = ',';
+            }
+
+            bytes += p - out;
+        }
+    }
+
+    const double seconds = now() - start;
+    const double serialized = (double) rounds * tokensCount;
+
+    printf("%-16s %12.0f tokens/s %10.1f MB/s\n", name, 
+        serialized / seconds, bytes / seconds / 1e6);
+
+    free(out);
+}
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : CODE_SOURCE_FILE;
+
+    size_t tokensCount;
+    Token* tokens = lexAll(path, &tokensCount);
+
+    if (tokensCount == 0) {
+        fprintf(stderr, "Benchmark Error: %s has no Tokens\n", path);
+        exit(1);
+    }
+
+    printf("%lu Tokens from %s\n", tokensCount, path);
+
+    benchmark("sprintf", sprintfSerializer, tokens, tokensCount);
+    benchmark("tokenSerializer", tokenSerializer_writeJson, tokens, tokensCount);
+
+    free(tokens);
+
+    return 0;
+}
\ No newline at end of file
@@ -1,17 +1,38 @@
 #include "extras/server/server.h"
 #include "extras/server/responseCreator/responseCreator.h"
+#include "extras/server/responseCache/responseCache.h"
+#include "extras/server/sourceBatch/sourceBatch.h"
+#include "extras/server/threadPool/threadPool.h"
 
 #include "symbolsTable/symbolsTable.h"
 #include "lexer/lexer.h"
+#include "lexer/tokenSerializer/tokenSerializer.h"
+#include "lexer/tokenStream/tokenStream.h"
+#include "lexer/incrementalLexer/incrementalLexer.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <signal.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <semaphore.h>
+#include <setjmp.h>
+#include <unistd.h>
+
+#define TOKENS_BLOCK_SIZE 256
+#define LEXER_CACHE_BYTE_BUDGET (64 * 1024 * 1024)
+#define BATCH_QUEUE_SIZE 4096
+//Offset and deleted size (u32 little endian each) before the inserted bytes
+#define EDIT_HEADER_SIZE 8
+//The source of an editor connection, the edits that make it bigger are refused
+#define EDITOR_SOURCE_MAX_SIZE (1024 * 1024)
 
 static volatile Server* serverReference = NULL;
-
-const char* getTokenTypeAsString(enum tokenType type);
+static ResponseCache* lexerCache = NULL;
+static Metrics* serverMetrics = NULL;
+static size_t tokensCounter;
+static ThreadPool* batchPool = NULL;
 
 void intHandler(int num) {
     if (serverReference != NULL)
@@ -20,81 +41,653 @@ void intHandler(int num) {
     exit(num);
 }
 
-char* createTempCodeFile(const char *content) {
-    char tempFilePath[] = "tempCode.XXXXXX";
+typedef struct {
+    const char *source;
+    size_t sourceSize;
+    SymbolsTable *st;
+    Lexer *l;
+    bool isStarted;
+    bool isFirstToken;
+    TokenStream *ts;
+    TokenStreamIterator it;
+    bool isBinary;
+    uint64_t cacheKey;
+    //Copy of the content sent so far, to be cached when the stream is over
+    char *captured;
+    size_t capturedSize;
+    size_t capturedCapacity;
+} LexerStream;
+
+//Each call lexes one block of Tokens, the server sends them when the chunk is full
+bool lexerJsonProducer(ResponseCreator *rc, void *stream) {
+    LexerStream *ls = (LexerStream*) stream;
+
+    if (!ls->isStarted) {
+        responseCreator_appendContent(rc, "[");
+        ls->isStarted = true;
+    }
 
-    int fd = mkstemp(tempFilePath);
-    FILE *tempFile = fdopen(fd, "w");
+    Token tokens[TOKENS_BLOCK_SIZE];
+    const size_t tokensCount = lexer_fillTokens(ls->l, tokens, TOKENS_BLOCK_SIZE);
+    metrics_add(serverMetrics, tokensCounter, tokensCount);
 
-    if (fd == -1 || tempFile == NULL) {
-        fprintf(stderr, "Runner Error => root: Unable to open temporary file\n");
-        exit(1);
+    //The Tokens are written straight into the response, one comma before each but the first
+    char *out = responseCreator_reserveBytes(rc, tokensCount * (TOKEN_SERIALIZER_JSON_MAX_SIZE + 1));
+    size_t written = 0;
+
+    for (size_t i = 0; i < tokensCount; i++) {
+        if (!ls->isFirstToken)
+            out[written++] = ',';
+
+        written += tokenSerializer_writeJson(&tokens[i], out + written);
+        ls->isFirstToken = false;
+    }
+
+    responseCreator_commitBytes(rc, written);
+
+    if (tokensCount == 0) {
+        responseCreator_appendContent(rc, "]");
+        return false;
+    }
+
+    return true;
+}
+
+/*
+    The symbols come before the Tokens in the binary format, so the first call
+    lexes the whole source and writes the header and the symbols, and the next
+    ones write the records of one block of Tokens each.
+*/
+bool lexerBinaryProducer(ResponseCreator *rc, void *stream) {
+    LexerStream *ls = (LexerStream*) stream;
+    Token tokens[TOKENS_BLOCK_SIZE];
+    size_t tokensCount;
+
+    if (!ls->isStarted) {
+        ls->ts = tokenStream_init();
+
+        while ((tokensCount = lexer_fillTokens(ls->l, tokens, TOKENS_BLOCK_SIZE)) > 0) {
+            for (size_t i = 0; i < tokensCount; i++)
+                tokenStream_append(ls->ts, tokens[i]);
+
+            metrics_add(serverMetrics, tokensCounter, tokensCount);
+        }
+
+        const size_t symbolsCount = symbolsTable_getSize(ls->st);
+
+        char *out = responseCreator_reserveBytes(rc, TOKEN_SERIALIZER_BINARY_HEADER_SIZE);
+        responseCreator_commitBytes(rc, tokenSerializer_writeBinaryHeader(symbolsCount, tokenStream_getSize(ls->ts), out));
+
+        for (size_t id = 1; id <= symbolsCount; id++) {
+            const size_t nameLen = symbolsTable_getNameLength(ls->st, id);
+
+            out = responseCreator_reserveBytes(rc, TOKEN_SERIALIZER_BINARY_SYMBOL_LENGTH_SIZE + nameLen);
+            responseCreator_commitBytes(rc, tokenSerializer_writeBinarySymbol(symbolsTable_getName(ls->st, id), nameLen, out));
+        }
+
+        ls->it = tokenStream_iterate(ls->ts);
+        ls->isStarted = true;
+
+        return true;
     }
 
-    fwrite(content, strlen(content), 1, tempFile);
+    char *out = responseCreator_reserveBytes(rc, TOKENS_BLOCK_SIZE * TOKEN_SERIALIZER_BINARY_RECORD_SIZE);
+    size_t written = 0;
+    Token t;
 
-    fclose(tempFile);
+    for (tokensCount = 0; tokensCount < TOKENS_BLOCK_SIZE && tokenStream_next(&ls->it, &t); tokensCount++)
+        written += tokenSerializer_writeBinaryToken(&t, out + written);
 
-    char *filePath = malloc(sizeof(char) * sizeof(tempFilePath));
-    strcpy(filePath, tempFilePath);
+    responseCreator_commitBytes(rc, written);
 
-    return filePath;
+    return tokensCount == TOKENS_BLOCK_SIZE;
 }
 
-ResponseCreator* lexer(Request r) {
-    const char *tokenJsonTemplate = 
-        "{"
-            "\"type\": \"%s\","
-            "\"location\": {"
-                "\"start\": {"
-                    "\"line\": %d,"
-                    "\"column\": %d"    
-                "},"
-                "\"end\": {"
-                    "\"line\": %d,"
-                    "\"column\": %d"    
-                "}"
-            "},"
-            "\"attr\": %s"
-        "}\0";
+//Stops capturing (the content is not cached) when it gets bigger than the cache budget
+void lexerCapture(LexerStream *ls, const char *content, size_t size) {
+    if (ls->captured == NULL)
+        return;
 
-    char* tempFilePath = createTempCodeFile(r.content);
-    char buff[255];
+    if (ls->capturedSize + size > LEXER_CACHE_BYTE_BUDGET) {
+        free(ls->captured);
+        ls->captured = NULL;
+        return;
+    }
 
-    SymbolsTable *st = symbolsTable_init();
-    Lexer *l = lexer_init(tempFilePath, 1024, st);
+    if (ls->capturedSize + size > ls->capturedCapacity) {
+        while (ls->capturedSize + size > ls->capturedCapacity)
+            ls->capturedCapacity *= 2;
 
-    ResponseCreator* rc = responseCreator_init(TYPE_JSON, 200);
+        char *captured = realloc(ls->captured, ls->capturedCapacity);
 
-    responseCreator_appendContent(rc, "[");
+        if (captured == NULL) {
+            fprintf(stderr, "Server Runner Error: Unable to allocate %lu bytes\n", ls->capturedCapacity);
+            exit(1);
+        }
 
-    while (lexer_hasNext(l)) {
-        Token t = lexer_getNextToken(l);
+        ls->captured = captured;
+    }
 
-        char attrBuff[50];
-        if (t.type == V_NUM_FLOAT)
-            sprintf(attrBuff, "%f", t.attribute.FLOAT_ATTR);
-        else
-            sprintf(attrBuff, "%d", t.attribute.INT_ATTR);
+    memcpy(ls->captured + ls->capturedSize, content, size);
+    ls->capturedSize += size;
+}
+
+//{"error":{"line":1,"column":5}}, where the error that jumped to the handler of the Lexer is
+void appendLexerError(ResponseCreator *rc, Lexer *l) {
+    const FilePosition position = lexer_getErrorPosition(l);
+    char json[96];
 
-        sprintf(buff, tokenJsonTemplate, getTokenTypeAsString(t.type), 
-            t.location.start.line, t.location.start.column, 
-            t.location.end.line, t.location.end.column,
-            attrBuff);
+    sprintf(json, "{\"error\":{\"line\":%lu,\"column\":%lu}}", position.line, position.column);
+    responseCreator_appendContent(rc, json);
+}
 
-        responseCreator_appendContent(rc, buff);
+/*
+    The header (200) can be sent already when the lexer finds an error, so the
+    error ends the content: the last element of the JSON array or, as nothing
+    of the binary format is written before the whole source is lexed, the
+    whole content instead of the Tokens document.
+*/
+bool lexerErrorProducer(ResponseCreator *rc, LexerStream *ls) {
+    if (ls->isBinary) {
+        appendLexerError(rc, ls->l);
+        return false;
+    }
 
-        if (lexer_hasNext(l))
-            responseCreator_appendContent(rc, ",");
+    if (!ls->isStarted) {
+        responseCreator_appendContent(rc, "[");
+        ls->isStarted = true;
     }
 
+    if (!ls->isFirstToken)
+        responseCreator_appendContent(rc, ",");
+
+    appendLexerError(rc, ls->l);
     responseCreator_appendContent(rc, "]");
 
-    lexer_free(l);
-    symbolsTable_free(st);
+    return false;
+}
+
+//Runs the producer of the format and keeps what it appended, the whole content is cached at the end
+bool lexerCachingProducer(ResponseCreator *rc, void *stream) {
+    LexerStream *ls = (LexerStream*) stream;
+    size_t sizeBefore, sizeAfter;
+    bool hasNext;
+    jmp_buf errorHandler;
+
+    responseCreator_getContent(rc, &sizeBefore);
+    lexer_setErrorHandler(ls->l, &errorHandler);
+
+    //The error is the end of the content, and is cached like the Tokens (the same source has the same error)
+    if (setjmp(errorHandler) == 0)
+        hasNext = ls->isBinary ? lexerBinaryProducer(rc, ls) : lexerJsonProducer(rc, ls);
+    else
+        hasNext = lexerErrorProducer(rc, ls);
+
+    const char *content = responseCreator_getContent(rc, &sizeAfter);
+    lexerCapture(ls, content + sizeBefore, sizeAfter - sizeBefore);
+
+    if (!hasNext && ls->captured != NULL)
+        responseCache_put(lexerCache, ls->cacheKey, ls->source, ls->sourceSize,
+                          ls->isBinary ? TYPE_BINARY : TYPE_JSON, ls->captured, ls->capturedSize);
+
+    return hasNext;
+}
+
+void lexerStreamFree(void *stream) {
+    LexerStream *ls = (LexerStream*) stream;
+
+    free(ls->captured);
+
+    if (ls->ts != NULL)
+        tokenStream_free(ls->ts);
+
+    lexer_free(ls->l);
+    symbolsTable_free(ls->st);
+    free(ls);
+}
+
+bool viewContains(StringView view, const char *str) {
+    const size_t strLen = strlen(str);
+
+    for (size_t i = 0; i + strLen <= view.size; i++) {
+        if (memcmp(view.data + i, str, strLen) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+//With "?format=bin" or "Accept: application/octet-stream" the Tokens are sent in the binary format
+bool isBinaryFormatRequested(Request r) {
+    const StringView format = server_getQueryParameter(r, "format");
+
+    if (format.data != NULL)
+        return format.size == 3 && memcmp(format.data, "bin", 3) == 0;
+
+    return viewContains(server_getHeader(r, "Accept"), "application/octet-stream");
+}
+
+//Without capture the content isn't copied aside (to be cached by lexerCachingProducer)
+LexerStream* lexerStreamInit(const char *source, size_t sourceSize, bool isBinary, uint64_t cacheKey, bool isCaptured) {
+    LexerStream *ls = malloc(sizeof(LexerStream));
+
+    if (ls == NULL) {
+        fprintf(stderr, "Server Runner Error: Unable to allocate the lexer stream\n");
+        exit(1);
+    }
+
+    ls->source = source;
+    ls->sourceSize = sourceSize;
+    ls->st = symbolsTable_init();
+    ls->l = lexer_initFromMemory(source, sourceSize, ls->st);
+    ls->isStarted = false;
+    ls->isFirstToken = true;
+    ls->ts = NULL;
+    ls->isBinary = isBinary;
+    ls->cacheKey = cacheKey;
+    ls->capturedSize = 0;
+    ls->capturedCapacity = 4096;
+    ls->captured = isCaptured ? malloc(ls->capturedCapacity) : NULL;
+
+    return ls;
+}
+
+ResponseCreator* lexer(Request r) {
+    const bool isBinary = isBinaryFormatRequested(r);
+    const enum content_type type = isBinary ? TYPE_BINARY : TYPE_JSON;
+
+    //The format is the seed, so the same source has one entry per format
+    const uint64_t cacheKey = responseCache_hash(r.content.data, r.content.size, type);
+
+    //A hit skips the lexer
+    ResponseCreator *cached = responseCache_get(lexerCache, cacheKey, r.content.data, r.content.size, type);
+
+    if (cached != NULL)
+        return cached;
+
+    //The content stays in the connection buffer until the whole response is sent
+    LexerStream *ls = lexerStreamInit(r.content.data, r.content.size, isBinary, cacheKey, true);
+
+    return responseCreator_initStream(type, 200, lexerCachingProducer, lexerStreamFree, ls);
+}
+
+#pragma region BATCH
+
+/*
+    The sources of a batch are lexed by the batch pool, each one with its own
+    Symbols Table, into a whole response of its own. The stream sends them in
+    order: the ready ones go out at once, and the worker of the connection
+    lexes the next one itself (or the first one nobody started after it) when
+    it isn't ready, so it only waits (on the semaphore, posted by each item)
+    while a pool thread is lexing the item it needs.
+    An item is lexed by whoever claims it first. The pool jobs and the stream
+    hold references, so a batch whose connection was closed is freed by the
+    last job (the items not started yet are skipped).
+*/
+typedef struct lexerBatch LexerBatch;
+
+typedef struct {
+    LexerBatch *batch;
+    size_t index;
+    ResponseCreator *result;
+    atomic_bool isClaimed;
+    atomic_bool isDone;
+} LexerBatchItem;
+
+struct lexerBatch {
+    SourceBatch *sources;
+    bool isBinary;
+    LexerBatchItem *items;
+    size_t itemsCount;
+    size_t nextItem;
+    //The items before it are claimed
+    size_t nextUnclaimed;
+    bool isStarted;
+    bool hasUnflushed;
+    sem_t finished;
+    atomic_bool isCancelled;
+    atomic_size_t references;
+};
+
+/*
+    The whole response of one source, from the cache when it was lexed before.
+    A lexer error only fails this source: the response is a JSON error with
+    where it is ({"error":{"line":1,"column":5}}), also in the binary format.
+*/
+ResponseCreator* lexSource(const char *source, size_t sourceSize, bool isBinary) {
+    const enum content_type type = isBinary ? TYPE_BINARY : TYPE_JSON;
+    const uint64_t cacheKey = responseCache_hash(source, sourceSize, type);
+    ResponseCreator *rc = responseCache_get(lexerCache, cacheKey, source, sourceSize, type);
+
+    if (rc != NULL)
+        return rc;
+
+    LexerStream *ls = lexerStreamInit(source, sourceSize, isBinary, cacheKey, false);
+    rc = responseCreator_init(type, 200);
+
+    jmp_buf errorHandler;
+    lexer_setErrorHandler(ls->l, &errorHandler);
+
+    if (setjmp(errorHandler) != 0) {
+        responseCreator_free(rc);
+        rc = responseCreator_init(TYPE_JSON, 400);
+        appendLexerError(rc, ls->l);
+
+        lexerStreamFree(ls);
+
+        return rc;
+    }
+
+    while (isBinary ? lexerBinaryProducer(rc, ls) : lexerJsonProducer(rc, ls));
+
+    size_t contentSize;
+    const char *content = responseCreator_getContent(rc, &contentSize);
+    responseCache_put(lexerCache, cacheKey, source, sourceSize, type, content, contentSize);
+
+    lexerStreamFree(ls);
+
+    return rc;
+}
+
+void lexerBatchRelease(LexerBatch *b) {
+    if (atomic_fetch_sub(&b->references, 1) != 1)
+        return;
+
+    for (size_t i = 0; i < b->itemsCount; i++) {
+        if (b->items[i].result != NULL)
+            responseCreator_free(b->items[i].result);
+    }
+
+    sem_destroy(&b->finished);
+    sourceBatch_free(b->sources);
+    free(b->items);
+    free(b);
+}
+
+//Only the first one to claim an item lexes it
+bool lexerBatchClaim(LexerBatchItem *item) {
+    return !atomic_exchange(&item->isClaimed, true);
+}
+
+void lexerBatchRun(LexerBatchItem *item) {
+    LexerBatch *b = item->batch;
+
+    if (!atomic_load(&b->isCancelled)) {
+        size_t sourceSize;
+        const char *source = sourceBatch_getSource(b->sources, item->index, &sourceSize);
+
+        item->result = lexSource(source, sourceSize, b->isBinary);
+    }
+
+    atomic_store(&item->isDone, true);
+    sem_post(&b->finished);
+}
+
+//The job of the batch pool, the item can be claimed by the stream already
+void lexBatchItem(void *context, void *job) {
+    LexerBatchItem *item = (LexerBatchItem*) job;
+    LexerBatch *b = item->batch;
+
+    if (lexerBatchClaim(item))
+        lexerBatchRun(item);
+
+    lexerBatchRelease(b);
+}
+
+//The first item that nobody claimed from the next one in order, NULL when every one is claimed
+LexerBatchItem* lexerBatchClaimNext(LexerBatch *b) {
+    if (b->nextUnclaimed < b->nextItem)
+        b->nextUnclaimed = b->nextItem;
+
+    while (b->nextUnclaimed < b->itemsCount) {
+        LexerBatchItem *item = &b->items[b->nextUnclaimed++];
+
+        if (lexerBatchClaim(item))
+            return item;
+    }
+
+    return NULL;
+}
+
+//JSON: an array with the array of Tokens of each source, binary: (u32 length, Tokens document) of each source
+bool lexerBatchProducer(ResponseCreator *rc, void *stream) {
+    LexerBatch *b = (LexerBatch*) stream;
+
+    if (!b->isStarted) {
+        if (!b->isBinary)
+            responseCreator_appendContent(rc, "[");
+
+        b->isStarted = true;
+    }
+
+    if (b->nextItem == b->itemsCount) {
+        if (!b->isBinary)
+            responseCreator_appendContent(rc, "]");
+
+        return false;
+    }
+
+    LexerBatchItem *item = &b->items[b->nextItem];
+
+    if (!atomic_load(&item->isDone)) {
+        //What is ready is sent before waiting
+        if (b->hasUnflushed) {
+            responseCreator_flushChunk(rc);
+            b->hasUnflushed = false;
+
+            return true;
+        }
+
+        //The worker lexes instead of waiting, while there are items nobody started
+        while (!atomic_load(&item->isDone)) {
+            LexerBatchItem *unclaimed = lexerBatchClaimNext(b);
+
+            if (unclaimed != NULL)
+                lexerBatchRun(unclaimed);
+            else
+                while (sem_wait(&b->finished) != 0);
+        }
+    }
+
+    size_t resultSize;
+    const char *result = responseCreator_getContent(item->result, &resultSize);
+
+    if (b->isBinary) {
+        const unsigned char length[SOURCE_BATCH_LENGTH_SIZE] = {
+            resultSize, resultSize >> 8, resultSize >> 16, resultSize >> 24
+        };
+
+        responseCreator_appendBytes(rc, length, SOURCE_BATCH_LENGTH_SIZE);
+    }
+    else if (b->nextItem > 0) {
+        responseCreator_appendContent(rc, ",");
+    }
+
+    responseCreator_appendBytes(rc, result, resultSize);
+
+    responseCreator_free(item->result);
+    item->result = NULL;
+
+    b->nextItem++;
+    b->hasUnflushed = true;
+
+    return true;
+}
+
+void lexerBatchFree(void *stream) {
+    LexerBatch *b = (LexerBatch*) stream;
+
+    atomic_store(&b->isCancelled, true);
+    lexerBatchRelease(b);
+}
+
+//The sources are a JSON array of strings or, with "Content-Type: application/octet-stream", length prefixed
+ResponseCreator* lexerBatch(Request r) {
+    SourceBatch *sources;
+
+    if (viewContains(server_getHeader(r, "Content-Type"), "application/octet-stream"))
+        sources = sourceBatch_fromBinary(r.content.data, r.content.size);
+    else
+        sources = sourceBatch_fromJson(r.content.data, r.content.size);
+
+    if (sources == NULL) {
+        ResponseCreator *rc = responseCreator_init(TYPE_JSON, 400);
+        responseCreator_appendContent(rc, "{\"error\":\"The sources must be a JSON array of strings or length prefixed\"}");
+
+        return rc;
+    }
+
+    LexerBatch *b = malloc(sizeof(LexerBatch));
+
+    if (b != NULL)
+        b->items = malloc(sizeof(LexerBatchItem) * (sourceBatch_getSize(sources) + 1));
+
+    if (b == NULL || b->items == NULL) {
+        fprintf(stderr, "Server Runner Error: Unable to allocate the batch\n");
+        exit(1);
+    }
+
+    b->sources = sources;
+    b->isBinary = isBinaryFormatRequested(r);
+    b->itemsCount = sourceBatch_getSize(sources);
+    b->nextItem = 0;
+    b->nextUnclaimed = 0;
+    b->isStarted = false;
+    b->hasUnflushed = false;
+    sem_init(&b->finished, 0, 0);
+    atomic_init(&b->isCancelled, false);
+    atomic_init(&b->references, b->itemsCount + 1);
+
+    for (size_t i = 0; i < b->itemsCount; i++) {
+        b->items[i].batch = b;
+        b->items[i].index = i;
+        b->items[i].result = NULL;
+        atomic_init(&b->items[i].isClaimed, false);
+        atomic_init(&b->items[i].isDone, false);
+    }
+
+    //With the pool queue full the item is left to the stream, that lexes the unclaimed ones
+    for (size_t i = 0; i < b->itemsCount; i++) {
+        if (!threadPool_submit(batchPool, &b->items[i]))
+            lexerBatchRelease(b);
+    }
+
+    const enum content_type type = b->isBinary ? TYPE_BINARY : TYPE_JSON;
+
+    return responseCreator_initStream(type, 200, lexerBatchProducer, lexerBatchFree, b);
+}
+
+#pragma endregion
 
-    remove(tempFilePath);
-    free(tempFilePath);
+#pragma region EDITOR
+
+/*
+    Each WebSocket connection of /lexer/ws keeps the source of one editor, its
+    Tokens and its Symbols Table. The client sends the edits and only the
+    Tokens that changed come back, see incrementalLexer.h for the other fields.
+*/
+void* lexerEditorOpen(Request r) {
+    return incrementalLexer_init();
+}
+
+void lexerEditorClose(void *state) {
+    incrementalLexer_free((IncrementalLexer*) state);
+}
+
+uint32_t readU32(const char *data) {
+    const unsigned char *p = (const unsigned char*) data;
+
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+//The edits out of the source are left to incrementalLexer_edit to refuse
+bool isEditorSourceTooBig(IncrementalLexer *il, size_t deletedSize, size_t insertedSize) {
+    const size_t sourceSize = incrementalLexer_getSourceSize(il);
+
+    return deletedSize <= sourceSize && sourceSize - deletedSize + insertedSize > EDITOR_SOURCE_MAX_SIZE;
+}
+
+ResponseCreator* lexerEditorMessage(void *state, StringView message) {
+    IncrementalLexer *il = (IncrementalLexer*) state;
+    ResponseCreator *rc = responseCreator_init(TYPE_JSON, 200);
+    TokenEdit edit;
+
+    if (message.size < EDIT_HEADER_SIZE ||
+        isEditorSourceTooBig(il, readU32(message.data + 4), message.size - EDIT_HEADER_SIZE) ||
+        !incrementalLexer_edit(il, readU32(message.data), readU32(message.data + 4),
+                               message.data + EDIT_HEADER_SIZE, message.size - EDIT_HEADER_SIZE, &edit)) {
+
+        responseCreator_appendContent(rc, "{\"error\":\"invalid edit\"}");
+        return rc;
+    }
+
+    char json[256];
+
+    sprintf(json, "{\"start\":%lu,\"deleted\":%lu,\"lineDelta\":%ld,\"shiftedLine\":%lu,\"columnDelta\":%ld,\"tokens\":[",
+            edit.start, edit.deleted, edit.lineDelta, edit.shiftedLine, edit.columnDelta);
+    responseCreator_appendContent(rc, json);
+
+    size_t tokensCount;
+    const Token *tokens = incrementalLexer_getTokens(il, &tokensCount) + edit.start;
+    metrics_add(serverMetrics, tokensCounter, edit.inserted);
+
+    char *out = responseCreator_reserveBytes(rc, edit.inserted * (TOKEN_SERIALIZER_JSON_MAX_SIZE + 1));
+    size_t written = 0;
+
+    for (size_t i = 0; i < edit.inserted; i++) {
+        if (i > 0)
+            out[written++] = ',';
+
+        written += tokenSerializer_writeJson(&tokens[i], out + written);
+    }
+
+    responseCreator_commitBytes(rc, written);
+
+    //The Tokens stop before an error, that is somewhere after the end of the last one
+    if (edit.hasError)
+        sprintf(json, "],\"error\":{\"line\":%lu,\"column\":%lu}}", edit.errorAfter.line, edit.errorAfter.column);
+    else
+        sprintf(json, "],\"error\":null}");
+
+    responseCreator_appendContent(rc, json);
+
+    return rc;
+}
+
+#pragma endregion
+
+ResponseCreator* lexerCacheStats(Request r) {
+    const ResponseCacheStats stats = responseCache_getStats(lexerCache);
+    char json[256];
+
+    sprintf(json, "{\"hits\":%lu,\"misses\":%lu,\"evictions\":%lu,\"entries\":%lu,\"bytes\":%lu,\"byteBudget\":%lu}",
+            stats.hits, stats.misses, stats.evictions, stats.entries, stats.bytes, stats.byteBudget);
+
+    ResponseCreator *rc = responseCreator_init(TYPE_JSON, 200);
+    responseCreator_appendContent(rc, json);
+
+    return rc;
+}
+
+void appendCacheMetric(ResponseCreator *rc, const char *name, const char *type, const char *help, uint64_t value) {
+    char lines[512];
+
+    sprintf(lines, "# HELP %s %s\n# TYPE %s %s\n%s %lu\n", name, help, name, type, name, value);
+    responseCreator_appendContent(rc, lines);
+}
+
+//The metrics of the server (and the Tokens counter) and the ones of the cache, that counts by itself
+ResponseCreator* metrics(Request r) {
+    const ResponseCacheStats stats = responseCache_getStats(lexerCache);
+    ResponseCreator *rc = responseCreator_init(TYPE_TEXT, 200);
+
+    metrics_write(serverMetrics, rc);
+
+    appendCacheMetric(rc, "lexer_cache_hits_total", "counter", "Responses of /lexer sent from the cache", stats.hits);
+    appendCacheMetric(rc, "lexer_cache_misses_total", "counter", "Responses of /lexer that were lexed", stats.misses);
+    appendCacheMetric(rc, "lexer_cache_evictions_total", "counter", "Responses evicted from the cache", stats.evictions);
+    appendCacheMetric(rc, "lexer_cache_entries", "gauge", "Responses in the cache", stats.entries);
+    appendCacheMetric(rc, "lexer_cache_bytes", "gauge", "Bytes of the responses in the cache", stats.bytes);
 
     return rc;
 }
@@ -102,99 +695,29 @@ ResponseCreator* lexer(Request r) {
 int main() {
     signal(SIGINT, intHandler);
 
-    Server* s = server_init(8000);
+    //One worker per core, the thread of server_start only does the I/O
+    Server* s = server_init(8000, sysconf(_SC_NPROCESSORS_ONLN));
     serverReference = s;
 
+    lexerCache = responseCache_init(LEXER_CACHE_BYTE_BUDGET);
+    batchPool = threadPool_init(sysconf(_SC_NPROCESSORS_ONLN), BATCH_QUEUE_SIZE, lexBatchItem, NULL);
+
+    serverMetrics = server_getMetrics(s);
+    tokensCounter = metrics_addCounter(serverMetrics, "lexer_tokens_total", NULL, "Tokens lexed by /lexer");
+
     server_addRoute(s, "/lexer", HTTP_POST, lexer);
+    server_addRoute(s, "/lexer/cache", HTTP_GET, lexerCacheStats);
+    server_addRoute(s, "/lexer/batch", HTTP_POST, lexerBatch);
+    server_addRoute(s, "/metrics", HTTP_GET, metrics);
+
+    const WebSocketHandlers lexerEditor = { lexerEditorOpen, lexerEditorMessage, lexerEditorClose };
+    server_addWebSocketRoute(s, "/lexer/ws", lexerEditor);
 
     server_start(s);
 
     server_free(s);
+    threadPool_free(batchPool);
+    responseCache_free(lexerCache);
 
     return 0;
 }
-
-const char* getTokenTypeAsString(enum tokenType type) {
-    switch (type) {
-        case I_ID:
-            return "I_ID";
-        case V_NUM_INT:
-            return "V_NUM_INT";
-        case V_NUM_FLOAT:
-            return "V_NUM_FLOAT";
-        case V_STRING:
-            return "V_STRING";
-        case R_VOID:
-            return "R_VOID";
-        case R_MAIN:
-            return "R_MAIN";
-        case R_IF:
-            return "R_IF";
-        case R_ELSE:
-            return "R_ELSE";
-        case R_FOR:
-            return "R_FOR";
-        case R_WHILE:
-            return "R_WHILE";
-        case R_INT:
-            return "R_INT";
-        case R_FLOAT:
-            return "R_FLOAT";
-        case R_CHAR:
-            return "R_CHAR";
-        case R_SCANF:
-            return "R_SCANF";
-        case R_PRINT:
-            return "R_PRINT";
-        case R_RETURN:
-            return "R_RETURN";
-        case S_OPEN_PARENTHESIS:
-            return "S_OPEN_PARENTHESIS";
-        case S_CLOSE_PARENTHESIS:
-            return "S_CLOSE_PARENTHESIS";
-        case S_OPEN_SQUARE_BRACKETS:
-            return "S_OPEN_SQUARE_BRACKETS";
-        case S_CLOSE_SQUARE_BRACKETS:
-            return "S_CLOSE_SQUARE_BRACKETS";
-        case S_OPEN_CURLY_BRACKETS:
-            return "S_OPEN_CURLY_BRACKETS";
-        case S_CLOSE_CURLY_BRACKETS:
-            return "S_CLOSE_CURLY_BRACKETS";
-        case S_ATTRIBUTION:
-            return "S_ATTRIBUTION";
-        case S_COMMA:
-            return "S_COMMA";
-        case S_SEMICOLON:
-            return "S_SEMICOLON";
-        case S_DOT:
-            return "S_DOT";
-        case O_EQUAL:
-            return "O_EQUAL";
-        case O_ADD:
-            return "O_ADD";
-        case O_SUBTRACT:
-            return "O_SUBTRACT";
-        case O_MULTIPLY:
-            return "O_MULTIPLY";
-        case O_DIVIDE:
-            return "O_DIVIDE";
-        case O_MOD:
-            return "O_MOD";
-        case O_LESS:
-            return "O_LESS";
-        case O_LESS_EQUAL:
-            return "O_LESS_EQUAL";
-        case O_GREATER:
-            return "O_GREATER";
-        case O_GREATER_EQUAL:
-            return "O_GREATER_EQUAL";
-        case O_INCREMENT:
-            return "O_INCREMENT";
-        case O_DECREMENT:
-            return "O_DECREMENT";
-        case C_LINE_COMMENT:
-            return "C_LINE_COMMENT";
-        case C_BLOCK_COMMENT:
-            return "C_BLOCK_COMMENT";
-    }
-}
@@ -3,17 +3,43 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
+#define ST_INITIAL_CAPACITY 1024
+#define ST_ARENA_BLOCK_SIZE 65536
+
+/*
+    Open addressing table with linear probing, each slot keeps the hash next to the
+    id, so a probe only touches the symbol name when the hashes are equal.
+    The names are stored in an arena and the symbols in an array indexed by the id,
+    which keeps the ids dense (1, 2, 3...) and the reverse lookup O(1).
+*/
+struct slot {
+    uint32_t hash;
+    uint32_t id;
+};
+
 struct symbol {
-    size_t id;
-    char* name; 
-    struct symbol *next;
+    const char* name;
+    size_t nameLen;
+    uint32_t hash;
+};
+
+struct arenaBlock {
+    struct arenaBlock *next;
+    size_t used;
+    size_t size;
+    char data[];
 };
 
 struct symbolsTable {
-    struct symbol *head;
-    int idCounter;
+    struct slot *slots;
+    size_t capacity;
+    struct symbol *symbols;
+    size_t symbolsCapacity;
+    size_t idCounter;
+    struct arenaBlock *arena;
 };
 
 void* ST_mallocOrExitWithError(size_t size) {
@@ -27,75 +53,173 @@ void* ST_mallocOrExitWithError(size_t size) {
     return m;
 }
 
-size_t ST_findByName(SymbolsTable* st, char* name) {
-    struct symbol *no = st->head;
+void* ST_callocOrExitWithError(size_t count, size_t size) {
+    void* m = calloc(count, size);
 
-    while (no != NULL) {
-        if (strcmp(no->name, name) == 0)
-            return no->id;
-        else
-            no = no->next;
+    if (m == NULL) {
+        fprintf(stderr, "Symbols Table Error: Unable to allocate %lu bytes\n", count * size);
+        exit(1);
     }
 
-    return 0;
+    return m;
 }
 
-size_t ST_add(SymbolsTable* st, char* name) {
-    struct symbol *no = ST_mallocOrExitWithError(sizeof(struct symbol));
+uint32_t ST_hash(const char* name, size_t nameLen) {
+    uint64_t hash = SYMBOLS_TABLE_HASH_INIT;
 
-    char *nameCopy = ST_mallocOrExitWithError(sizeof(char) * strlen(name) + 1);
-    strcpy(nameCopy, name);
+    for (size_t i = 0; i < nameLen; i++)
+        hash = symbolsTable_hashStep(hash, name[i]);
 
-    st->idCounter++;
-    no->id = st->idCounter;
-    no->name = nameCopy;
-    no->next = NULL;
+    return symbolsTable_hashFinish(hash);
+}
+
+const char* ST_storeName(SymbolsTable* st, const char* name, size_t nameLen) {
+    struct arenaBlock *block = st->arena;
+    const size_t needed = nameLen + 1;
+
+    if (block == NULL || block->size - block->used < needed) {
+        const size_t blockSize = needed > ST_ARENA_BLOCK_SIZE ? needed : ST_ARENA_BLOCK_SIZE;
+
+        block = ST_mallocOrExitWithError(sizeof(struct arenaBlock) + blockSize);
+        block->next = st->arena;
+        block->used = 0;
+        block->size = blockSize;
 
-    if (st->head == NULL) {
-        st->head = no;
+        st->arena = block;
     }
-    else {
-        struct symbol *aux = st->head;
 
-        while (aux->next != NULL)
-            aux = aux->next;
+    char *nameCopy = block->data + block->used;
+    memcpy(nameCopy, name, nameLen);
+    nameCopy[nameLen] = 0;
+
+    block->used += needed;
+
+    return nameCopy;
+}
+
+void ST_grow(SymbolsTable* st) {
+    const size_t newCapacity = st->capacity * 2;
+    const size_t mask = newCapacity - 1;
+    struct slot *newSlots = ST_callocOrExitWithError(newCapacity, sizeof(struct slot));
+
+    //Symbols keep their hash, so rehashing never touches the names
+    for (size_t id = 1; id <= st->idCounter; id++) {
+        size_t i = st->symbols[id - 1].hash & mask;
+
+        while (newSlots[i].id != 0)
+            i = (i + 1) & mask;
+
+        newSlots[i].hash = st->symbols[id - 1].hash;
+        newSlots[i].id = id;
+    }
+
+    free(st->slots);
+    st->slots = newSlots;
+    st->capacity = newCapacity;
+}
+
+size_t ST_add(SymbolsTable* st, size_t slotIndex, uint32_t hash, const char* name, size_t nameLen) {
+    if (st->idCounter == st->symbolsCapacity) {
+        st->symbolsCapacity *= 2;
+        st->symbols = realloc(st->symbols, sizeof(struct symbol) * st->symbolsCapacity);
 
-        aux->next = no;
+        if (st->symbols == NULL) {
+            fprintf(stderr, "Symbols Table Error: Unable to allocate %lu bytes\n",
+                sizeof(struct symbol) * st->symbolsCapacity);
+            exit(1);
+        }
     }
 
-    return no->id;
+    st->idCounter++;
+
+    struct symbol *symbol = &st->symbols[st->idCounter - 1];
+    symbol->name = ST_storeName(st, name, nameLen);
+    symbol->nameLen = nameLen;
+    symbol->hash = hash;
+
+    st->slots[slotIndex].hash = hash;
+    st->slots[slotIndex].id = st->idCounter;
+
+    //Keep the load factor under 1/2 so the probe sequences stay short
+    if (st->idCounter * 2 > st->capacity)
+        ST_grow(st);
+
+    return st->idCounter;
 }
 
 SymbolsTable* symbolsTable_init() {
     SymbolsTable* st = (SymbolsTable*) malloc(sizeof(SymbolsTable));
 
     if (st != NULL) {
-        st->head = NULL;
+        st->capacity = ST_INITIAL_CAPACITY;
+        st->slots = ST_callocOrExitWithError(st->capacity, sizeof(struct slot));
+
+        st->symbolsCapacity = ST_INITIAL_CAPACITY / 2;
+        st->symbols = ST_mallocOrExitWithError(sizeof(struct symbol) * st->symbolsCapacity);
+
         st->idCounter = 0;
+        st->arena = NULL;
     }
 
     return st;
 }
 
 void symbolsTable_free(SymbolsTable* st) {
-    struct symbol *no;
+    struct arenaBlock *block;
 
-    while (st->head != NULL) {
-        no = st->head;
-        st->head = st->head->next;
+    while (st->arena != NULL) {
+        block = st->arena;
+        st->arena = st->arena->next;
 
-        free(no->name);
-        free(no);
+        free(block);
     }
 
+    free(st->slots);
+    free(st->symbols);
     free(st);
 }
 
 size_t symbolsTable_getIdOrAddSymbol(SymbolsTable* st, char* symbolName) {
-    size_t foundId = ST_findByName(st, symbolName);
+    return symbolsTable_getIdOrAddSymbolWithLength(st, symbolName, strlen(symbolName));
+}
+
+size_t symbolsTable_getIdOrAddSymbolWithLength(SymbolsTable* st, const char* symbolName, size_t symbolLen) {
+    return symbolsTable_getIdOrAddHashedSymbol(st, symbolName, symbolLen, ST_hash(symbolName, symbolLen));
+}
+
+size_t symbolsTable_getIdOrAddHashedSymbol(SymbolsTable* st, const char* symbolName, size_t symbolLen,
+                                           uint32_t hash) {
+    const size_t mask = st->capacity - 1;
+    size_t i = hash & mask;
+
+    while (st->slots[i].id != 0) {
+        if (st->slots[i].hash == hash) {
+            const struct symbol *symbol = &st->symbols[st->slots[i].id - 1];
+
+            if (symbol->nameLen == symbolLen && memcmp(symbol->name, symbolName, symbolLen) == 0)
+                return st->slots[i].id;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    return ST_add(st, i, hash, symbolName, symbolLen);
+}
+
+const char* symbolsTable_getName(SymbolsTable* st, size_t id) {
+    if (id == 0 || id > st->idCounter)
+        return NULL;
+
+    return st->symbols[id - 1].name;
+}
+
+size_t symbolsTable_getNameLength(SymbolsTable* st, size_t id) {
+    if (id == 0 || id > st->idCounter)
+        return 0;
+
+    return st->symbols[id - 1].nameLen;
+}
 
-    if (foundId != 0)
-        return foundId;
-    else
-        return ST_add(st, symbolName);
+size_t symbolsTable_getSize(SymbolsTable* st) {
+    return st->idCounter;
 }
\ No newline at end of file
@@ -2,6 +2,25 @@
 #define SYMBOLS_TABLE_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+/*
+    FNV-1a, exposed so a caller can hash a name while reading it:
+        hash = SYMBOLS_TABLE_HASH_INIT;
+        hash = symbolsTable_hashStep(hash, ch); for each char
+        symbolsTable_hashFinish(hash);
+*/
+#define SYMBOLS_TABLE_HASH_INIT 14695981039346656037ULL
+#define SYMBOLS_TABLE_HASH_PRIME 1099511628211ULL
+
+static inline uint64_t symbolsTable_hashStep(uint64_t hash, char ch) {
+    return (hash ^ (unsigned char) ch) * SYMBOLS_TABLE_HASH_PRIME;
+}
+
+static inline uint32_t symbolsTable_hashFinish(uint64_t hash) {
+    //Fold the high bits in, the probing only looks at the low ones
+    return (uint32_t) (hash ^ (hash >> 32));
+}
 
 typedef struct symbolsTable SymbolsTable;
 
@@ -9,5 +28,11 @@ SymbolsTable* symbolsTable_init();
 void symbolsTable_free(SymbolsTable* st);
 
 size_t symbolsTable_getIdOrAddSymbol(SymbolsTable* st, char* symbolName);
+size_t symbolsTable_getIdOrAddSymbolWithLength(SymbolsTable* st, const char* symbolName, size_t symbolLen);
+size_t symbolsTable_getIdOrAddHashedSymbol(SymbolsTable* st, const char* symbolName, size_t symbolLen,
+                                           uint32_t hash);
+const char* symbolsTable_getName(SymbolsTable* st, size_t id);
+size_t symbolsTable_getNameLength(SymbolsTable* st, size_t id);
+size_t symbolsTable_getSize(SymbolsTable* st);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../extras/server/metrics/metrics.h"
+
+#define HISTOGRAMS_COUNT 200
+#define COUNTERS_COUNT 100
+
+static Metrics* metrics;
+static size_t histograms[HISTOGRAMS_COUNT];
+static size_t counters[COUNTERS_COUNT];
+
+void* observe(void* arg) {
+    for (size_t i = 0; i < HISTOGRAMS_COUNT; i++)
+        metrics_observe(metrics, histograms[i], 1000 * (i + 1));
+
+    for (size_t i = 0; i < COUNTERS_COUNT; i++)
+        metrics_add(metrics, counters[i], i);
+
+    return NULL;
+}
+
+int main() {
+    int failures = 0;
+    metrics = metrics_init();
+
+    //More metrics than a segment of a shard and a label longer than a line used to be
+    char path[600];
+    memset(path, 'a', sizeof(path) - 1);
+    path[sizeof(path) - 1] = 0;
+    memcpy(path, "/\"q\"\\", 5);
+
+    char escaped[sizeof(path) * 2];
+    metrics_escapeLabelValue(escaped, path);
+
+    const size_t labelsSize = strlen(escaped) + 32;
+    char* labels = malloc(labelsSize);
+
+    for (size_t i = 0; i < HISTOGRAMS_COUNT; i++) {
+        snprintf(labels, labelsSize, "id=\"%lu\",route=\"%s\"", i, escaped);
+        histograms[i] = metrics_addHistogram(metrics, "test_seconds", labels, "Test histogram");
+    }
+
+    for (size_t i = 0; i < COUNTERS_COUNT; i++) {
+        snprintf(labels, labelsSize, "id=\"%lu\"", i);
+        counters[i] = metrics_addCounter(metrics, "test_total", labels, "Test counter");
+    }
+
+    pthread_t threads[2];
+    for (size_t i = 0; i < 2; i++)
+        pthread_create(&threads[i], NULL, observe, NULL);
+
+    for (size_t i = 0; i < 2; i++)
+        pthread_join(threads[i], NULL);
+
+    ResponseCreator* rc = responseCreator_init(TYPE_TEXT, 200);
+    metrics_write(metrics, rc);
+
+    size_t size;
+    const char* content = responseCreator_getContent(rc, &size);
+    char* text = malloc(size + 1);
+    memcpy(text, content, size);
+    text[size] = 0;
+
+    snprintf(labels, labelsSize, "test_seconds_count{id=\"%d\",route=\"%s\"} 2\n", HISTOGRAMS_COUNT - 1, escaped);
+    if (strstr(text, labels) == NULL) {
+        printf("FAIL the count of the last histogram isn't whole\n");
+        failures++;
+    }
+
+    if (strstr(text, "\\\"q\\\"\\\\aaa") == NULL) {
+        printf("FAIL the route isn't escaped\n");
+        failures++;
+    }
+
+    snprintf(labels, labelsSize, "test_total{id=\"%d\"} %d\n", COUNTERS_COUNT - 1, 2 * (COUNTERS_COUNT - 1));
+    if (strstr(text, labels) == NULL) {
+        printf("FAIL the last counter isn't merged\n");
+        failures++;
+    }
+
+    free(text);
+    free(labels);
+    responseCreator_free(rc);
+    metrics_free(metrics);
+
+    printf("metricsTest: %s\n", failures == 0 ? "ok" : "failed");
+
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../extras/server/responseCache/responseCache.h"
+
+static int failures = 0;
+
+void expectContent(const char* name, ResponseCreator* response, const char* expected) {
+    size_t size = 0;
+    const char* content = response != NULL ? responseCreator_getContent(response, &size) : NULL;
+
+    const bool isExpected = expected == NULL ? response == NULL :
+                            response != NULL && size == strlen(expected) && memcmp(content, expected, size) == 0;
+
+    if (!isExpected) {
+        printf("FAIL %s: got %.*s, expected %s\n", name, (int) size, content != NULL ? content : "NULL",
+               expected != NULL ? expected : "NULL");
+        failures++;
+    }
+
+    if (response != NULL)
+        responseCreator_free(response);
+}
+
+int main() {
+    ResponseCache* cache = responseCache_init(1024);
+    const uint64_t key = responseCache_hash("int a;", 6, TYPE_JSON);
+
+    responseCache_put(cache, key, "int a;", 6, TYPE_JSON, "[a]", 3);
+
+    expectContent("same request", responseCache_get(cache, key, "int a;", 6, TYPE_JSON), "[a]");
+    expectContent("other type", responseCache_get(cache, key, "int a;", 6, TYPE_BINARY), NULL);
+
+    //The same key for another request is a collision, the cached content isn't served for it
+    expectContent("collision", responseCache_get(cache, key, "int b;", 6, TYPE_JSON), NULL);
+    expectContent("collision of other size", responseCache_get(cache, key, "int bc;", 7, TYPE_JSON), NULL);
+
+    //The request counts in the budget
+    responseCache_put(cache, 1, "x", 1, TYPE_JSON, "y", 1);
+    const ResponseCacheStats stats = responseCache_getStats(cache);
+
+    if (stats.bytes != 6 + 3 + 1 + 1 || stats.hits != 1 || stats.misses != 3) {
+        printf("FAIL stats: %lu bytes, %lu hits, %lu misses\n", stats.bytes, stats.hits, stats.misses);
+        failures++;
+    }
+
+    responseCache_free(cache);
+
+    printf("responseCacheTest: %s\n", failures == 0 ? "ok" : "failed");
+
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#!/bin/bash
+# Sends raw requests to the server of serverRunner.c (port 8000) and checks the answers
+cd "$(dirname "$0")/.."
+
+./server.out > /dev/null 2>&1 &
+SERVER_PID=$!
+trap 'kill -INT $SERVER_PID 2> /dev/null; wait $SERVER_PID 2> /dev/null' EXIT
+
+for i in $(seq 50); do
+    (exec 3<> /dev/tcp/localhost/8000) 2> /dev/null && break
+    sleep 0.1
+done
+
+FAILURES=0
+
+# Status lines of the responses to the raw request, until the server closes the connection
+# (a response with Content-Length is followed by the next one in the same line)
+statusLines() {
+    exec 3<> /dev/tcp/localhost/8000
+    printf "$1" >&3
+    timeout 2 cat <&3 | tr -d '\r' | grep -ao 'HTTP/1\.1 [0-9]\{3\} [A-Z ]*'
+    exec 3<&-
+}
+
+expect() {
+    local got
+    got=$(statusLines "$2" | tr '\n' '|')
+
+    if [ "$got" != "$3" ]; then
+        echo "FAIL $1: got '$got', expected '$3'"
+        FAILURES=$((FAILURES + 1))
+    fi
+}
+
+LEXER='POST /lexer HTTP/1.1\r\nHost: x\r\n'
+CLOSE='GET /nothing HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n'
+
+expect "valid" "${LEXER}Content-Length: 6\r\n\r\nint a;${CLOSE}" "HTTP/1.1 200 OK|HTTP/1.1 404 NOT FOUND|"
+# The wrapped sizes (2^64 - 1 and 2^64) are refused and what comes after isn't read as a request
+expect "huge" "${LEXER}Content-Length: 18446744073709551615\r\n\r\n${CLOSE}" "HTTP/1.1 413 PAYLOAD TOO LARGE|"
+expect "wrapped" "${LEXER}Content-Length: 18446744073709551616\r\n\r\n${CLOSE}" "HTTP/1.1 413 PAYLOAD TOO LARGE|"
+expect "too big" "${LEXER}Content-Length: 1000001\r\n\r\n${CLOSE}" "HTTP/1.1 413 PAYLOAD TOO LARGE|"
+expect "trailing garbage" "${LEXER}Content-Length: 6abc\r\n\r\nint a;${CLOSE}" "HTTP/1.1 400 BAD REQUEST|"
+expect "two values" "${LEXER}Content-Length: 6, 6\r\n\r\nint a;${CLOSE}" "HTTP/1.1 400 BAD REQUEST|"
+expect "empty" "${LEXER}Content-Length: \r\n\r\n${CLOSE}" "HTTP/1.1 400 BAD REQUEST|"
+expect "negative" "${LEXER}Content-Length: -1\r\n\r\n${CLOSE}" "HTTP/1.1 400 BAD REQUEST|"
+# A lexer error ends the content of its own response, the server keeps answering
+expect "lexer error" "${LEXER}Content-Length: 7\r\n\r\nx = 1a;${CLOSE}" "HTTP/1.1 200 OK|HTTP/1.1 404 NOT FOUND|"
+expect "after lexer error" "${LEXER}Content-Length: 6\r\n\r\nint a;${CLOSE}" "HTTP/1.1 200 OK|HTTP/1.1 404 NOT FOUND|"
+
+echo "serverTest: $([ $FAILURES -eq 0 ] && echo ok || echo failed)"
+[ $FAILURES -eq 0 ]
\ No newline at end of file
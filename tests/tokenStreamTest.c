@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../lexer/lexer.h"
+#include "../lexer/tokenStream/tokenStream.h"
+#include "../symbolsTable/symbolsTable.h"
+
+//Blank lines and a multi-line comment, the lines where no Token starts or ends
+#define SOURCE "int a;\n\n\n/* one\n\n   two */\nvoid main() {\n\n    a = 1.5;\n}\n"
+
+static int failures = 0;
+
+void expectPosition(const char* name, FilePosition got, FilePosition expected) {
+    if (got.line == expected.line && got.column == expected.column && got.offset == expected.offset)
+        return;
+
+    printf("FAIL %s: got %lu:%lu@%lu, expected %lu:%lu@%lu\n", name,
+           got.line, got.column, got.offset, expected.line, expected.column, expected.offset);
+    failures++;
+}
+
+int main() {
+    SymbolsTable* st = symbolsTable_init();
+    Lexer* l = lexer_initFromMemory(SOURCE, strlen(SOURCE), st);
+    TokenStream* ts = tokenStream_init();
+
+    Token tokens[64];
+    size_t tokensCount = 0;
+    Token t;
+
+    while ((t = lexer_getNextToken(l)).type != E_EOF) {
+        tokens[tokensCount++] = t;
+        tokenStream_append(ts, t);
+    }
+
+    //The supported offsets: where each Token starts and ends, also after the lines without one
+    for (size_t i = 0; i < tokensCount; i++) {
+        expectPosition("token start", tokenStream_getPosition(ts, tokens[i].location.start.offset), tokens[i].location.start);
+        expectPosition("token end", tokenStream_getPosition(ts, tokens[i].location.end.offset), tokens[i].location.end);
+    }
+
+    tokenStream_free(ts);
+    lexer_free(l);
+    symbolsTable_free(st);
+
+    printf("tokenStreamTest: %s\n", failures == 0 ? "ok" : "failed");
+
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
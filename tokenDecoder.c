@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lexer/lexer.h"
+#include "lexer/tokenSerializer/tokenSerializer.h"
+
+#define READ_BLOCK_SIZE 65536
+
+/*
+    Prints the Tokens of the binary format of the /lexer route, read from the
+    given file or from the standard input:
+        $ curl --data-binary @code_example.txt "localhost:8000/lexer?format=bin" | ./decoder.out
+*/
+
+typedef struct {
+    const char* name;
+    uint32_t nameLen;
+} Symbol;
+
+void* mallocOrExitWithError(size_t size) {
+    void* m = malloc(size);
+
+    if (m == NULL) {
+        fprintf(stderr, "Decoder Error: Unable to allocate %lu bytes\n", size);
+        exit(1);
+    }
+
+    return m;
+}
+
+void exitWithTruncatedError() {
+    fprintf(stderr, "Decoder Error: The input ends in the middle of the data\n");
+    exit(1);
+}
+
+char* readAll(FILE* input, size_t* size) {
+    size_t capacity = READ_BLOCK_SIZE;
+    char* data = mallocOrExitWithError(capacity);
+    size_t read;
+
+    *size = 0;
+
+    while ((read = fread(data + *size, 1, capacity - *size, input)) > 0) {
+        *size += read;
+
+        if (*size == capacity) {
+            capacity *= 2;
+            data = realloc(data, capacity);
+
+            if (data == NULL) {
+                fprintf(stderr, "Decoder Error: Unable to allocate %lu bytes\n", capacity);
+                exit(1);
+            }
+        }
+    }
+
+    return data;
+}
+
+void printToken(Token t, Symbol* symbols, uint32_t symbolsCount) {
+    printf("Token => type: %s\n"
+           "\tPosition => start %ld:%ld ; end %ld:%ld\n",
+           tokenSerializer_getTypeName(t.type, NULL),
+           t.location.start.line, t.location.start.column,
+           t.location.end.line, t.location.end.column);
+
+    if (t.type == V_NUM_FLOAT)
+        printf("\tattr: %f\n", t.attribute.FLOAT_ATTR);
+    else
+        printf("\tattr: %d\n", t.attribute.INT_ATTR);
+
+    //The ids start at 1
+    if ((t.type == I_ID || t.type == V_STRING) && t.attribute.INT_ATTR >= 1 && (uint32_t) t.attribute.INT_ATTR <= symbolsCount) {
+        const Symbol symbol = symbols[t.attribute.INT_ATTR - 1];
+        printf("\tsymbol: %.*s\n", (int) symbol.nameLen, symbol.name);
+    }
+
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    FILE* input = stdin;
+
+    if (argc > 1 && (input = fopen(argv[1], "rb")) == NULL) {
+        fprintf(stderr, "Decoder Error: Unable to open %s\n", argv[1]);
+        exit(1);
+    }
+
+    size_t size;
+    char* data = readAll(input, &size);
+    const char* end = data + size;
+
+    if (input != stdin)
+        fclose(input);
+
+    TokenBinaryHeader header;
+
+    if (size < TOKEN_SERIALIZER_BINARY_HEADER_SIZE || !tokenSerializer_readBinaryHeader(data, &header)) {
+        fprintf(stderr, "Decoder Error: The input is not in the binary Tokens format\n");
+        exit(1);
+    }
+
+    if (header.version != TOKEN_SERIALIZER_BINARY_VERSION || header.recordSize < TOKEN_SERIALIZER_BINARY_RECORD_SIZE) {
+        fprintf(stderr, "Decoder Error: Unknown version %u (record size %u)\n", header.version, header.recordSize);
+        exit(1);
+    }
+
+    const char* current = data + TOKEN_SERIALIZER_BINARY_HEADER_SIZE;
+
+    //Each symbol has at least its length, so the counts that can't fit in the input are refused before the allocation
+    if (header.symbolsCount > (size_t) (end - current) / TOKEN_SERIALIZER_BINARY_SYMBOL_LENGTH_SIZE)
+        exitWithTruncatedError();
+
+    Symbol* symbols = mallocOrExitWithError(sizeof(Symbol) * ((size_t) header.symbolsCount + 1));
+
+    for (uint32_t i = 0; i < header.symbolsCount; i++) {
+        if (end - current < TOKEN_SERIALIZER_BINARY_SYMBOL_LENGTH_SIZE)
+            exitWithTruncatedError();
+
+        symbols[i].name = tokenSerializer_readBinarySymbol(current, &symbols[i].nameLen);
+
+        if ((size_t) (end - symbols[i].name) < symbols[i].nameLen)
+            exitWithTruncatedError();
+
+        current = symbols[i].name + symbols[i].nameLen;
+    }
+
+    if (header.tokensCount > (size_t) (end - current) / header.recordSize)
+        exitWithTruncatedError();
+
+    //Newer versions can have bigger records, the known part is at the start
+    for (uint32_t i = 0; i < header.tokensCount; i++) {
+        const Token t = tokenSerializer_readBinaryToken(current);
+
+        if (t.type > E_EOF) {
+            fprintf(stderr, "Decoder Error: Unknown Token type %u in the Token %u\n", (unsigned int) t.type, i);
+            exit(1);
+        }
+
+        printToken(t, symbols, header.symbolsCount);
+        current += header.recordSize;
+    }
+
+    free(symbols);
+    free(data);
+
+    return 0;
+}
\ No newline at end of file